@@ -1,160 +1,2332 @@
 #include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <execinfo.h>
+#include <time.h>
+#include "mmu_shm_stats.h"
 
 #define ALIGNMENT 8
 #define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~(ALIGNMENT-1)) // Aligns the size to the nearest multiple of ALIGNMENT
-#define BLOCK_SIZE sizeof(block_t) // Defines the size of the block metadata structure
+#define BLOCK_SIZE offsetof(block_t, next_free) // Only the size word precedes the payload
+#define MIN_PAYLOAD (3 * sizeof(size_t)) // A free block must hold its two bin links and its footer
 
-// Metadata structure for each memory block
+// Alignment of the pointers my_malloc, my_calloc and my_realloc return, a power of two. Block payloads
+// only sit at multiples of ALIGNMENT, so anything larger costs an aligned allocation for requests that
+// do not fit a slab; the malloc shim raises it to 16 as the x86-64 and AArch64 ABIs require.
+#ifndef MALLOC_ALIGNMENT
+#define MALLOC_ALIGNMENT ALIGNMENT
+#endif
+
+// Flags kept in the low bits of the size word (sizes are multiples of ALIGNMENT)
+#define BLOCK_FREE 1        // The block is free (in a bin or the top block)
+#define BLOCK_MMAPPED 2     // The block owns a dedicated mapping
+#define BLOCK_PREV_IN_USE 4 // The physically previous block is in use, or there is none
+#define BLOCK_FLAGS (BLOCK_FREE | BLOCK_MMAPPED | BLOCK_PREV_IN_USE)
+
+// Size classes: exact bins every ALIGNMENT bytes up to SMALL_BIN_MAX, then one bin per power of two
+#define NUM_SMALL_BINS 64
+#define SMALL_BIN_MAX (NUM_SMALL_BINS * ALIGNMENT) // Largest size served by an exact bin (512 bytes)
+#define NUM_BINS 128
+#define BINMAP_WORDS (NUM_BINS / 64)
+#define FIT_SEARCH_LIMIT 8 // Blocks of a log-spaced bin tried before moving on to larger bins
+
+// Small requests are carved out of large arena chunks; chunk sizes grow geometrically so a growing
+// heap needs only a handful of mmap calls. Both limits can be overridden before including this header.
+#ifndef ARENA_CHUNK_SIZE
+#define ARENA_CHUNK_SIZE (1024 * 1024) // Size of the first arena chunk
+#endif
+#ifndef ARENA_CHUNK_MAX
+#define ARENA_CHUNK_MAX (64 * 1024 * 1024) // Chunk sizes double up to this cap
+#endif
+#ifndef MMAP_THRESHOLD
+#define MMAP_THRESHOLD (128 * 1024) // Requests at least this large get a dedicated mapping
+#endif
+
+// Threads are spread round-robin over MAX_ARENAS arenas, each with its own lock. In front of that,
+// every thread keeps a small cache of free blocks per exact size class that it can use without locking.
+// A block freed by a thread of another arena is pushed onto that arena's lock-free remote-free list
+// and merged back by whichever thread next takes the arena's lock.
+#ifndef MAX_ARENAS
+#define MAX_ARENAS 8
+#endif
+#if MAX_ARENAS > STATS_SHM_MAX_ARENAS
+#error "MAX_ARENAS is larger than the stats page in mmu_shm_stats.h has room for"
+#endif
+#ifndef TCACHE_COUNT
+#define TCACHE_COUNT 32 // Blocks a thread may cache per size class
+#endif
+#define TCACHE_MAX_SIZE SMALL_BIN_MAX // Largest block size kept in the thread cache
+
+// Arena chunks and slab regions are aligned to REGION_SIZE (or a huge page, see below) and registered
+// in a byte map with one entry per REGION_SIZE of address space, holding the owning arena's index + 1
+// (REGION_SLAB set for slab regions). my_free finds a pointer's arena with one lookup instead of reading
+// it from a header.
+#define REGION_SHIFT 20
+#define REGION_SIZE (1UL << REGION_SHIFT)
+#define REGION_ADDRESS_BITS 47 // User-space address bits covered by the region map
+#define REGION_SLAB 0x80
+
+// Free memory is handed back to the kernel once it has stayed unused for PURGE_DECAY_MS: whole pages
+// inside large free blocks and the top block are purged with PURGE_ADVICE, and arena chunks that became
+// entirely free are unmapped. The delay keeps bursty workloads from faulting the same pages in repeatedly.
+#ifndef PURGE_DECAY_MS
+#define PURGE_DECAY_MS 1000 // 0 purges on the next arena operation, -1 never purges
+#endif
+#ifndef PURGE_ADVICE
+#define PURGE_ADVICE MADV_DONTNEED // MADV_FREE is cheaper but leaves RSS until the kernel needs the pages
+#endif
+#define PURGE_MIN_SIZE (64 * 1024) // Free blocks smaller than this are never purged
+
+// Huge pages: arena chunks and slab regions are reserved HUGE_PAGE_SIZE-aligned in whole huge pages and
+// marked MADV_HUGEPAGE, so the kernel backs them with transparent huge pages and small objects packed
+// into them share few TLB entries. HUGEPAGE_HUGETLB first tries MAP_HUGETLB pages from the reserved pool,
+// falling back to transparent ones. Dedicated mappings of a huge page or more are marked as well, and
+// purging only gives back whole huge pages so it never splits one. HUGEPAGE_ENV, when set at startup
+// to "off", "thp" or "hugetlb", overrides the compiled-in mode.
+#define HUGEPAGE_OFF 0
+#define HUGEPAGE_THP 1
+#define HUGEPAGE_HUGETLB 2
+#ifndef HUGEPAGE_MODE
+#define HUGEPAGE_MODE HUGEPAGE_OFF
+#endif
+#define HUGEPAGE_ENV "MY_MALLOC_HUGEPAGES"
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+
+// Live counters can be published to a file under /dev/shm for an external monitor (see heapmon.c),
+// either by calling my_malloc_stats_shm or by naming the file in this environment variable. The page's
+// layout is in mmu_shm_stats.h.
+#define STATS_SHM_ENV "MY_MALLOC_STATS_SHM"
+
+// Sampling heap profiler: when started, about one allocation per PROFILE_RATE bytes allocated (at
+// exponentially distributed intervals) gets its own mapping and a recorded backtrace, so my_free only has
+// to look for samples among mapped blocks. my_malloc_profile_dump writes the live samples, scaled up to
+// estimates for the whole heap, in the legacy gperftools heap profile format that pprof reads.
+#define PROFILE_ENV "MY_MALLOC_PROFILE_RATE" // Starts the profiler at this sampling rate, in bytes
+#define PROFILE_MAX_SAMPLES 65536            // Table slots; up to half of them hold live samples, beyond that nothing is sampled
+#define PROFILE_DEPTH 32                     // Stack frames recorded per sample
+#define PROFILE_IDLE_CHECK (1024 * 1024)     // Bytes between checks for a started profiler while it is off
+
+// Trace recording: every my_malloc/my_calloc/my_realloc/my_free call is appended to a binary file that
+// trace_replay.c replays. Records are buffered per thread and written in blocks; each block is in time
+// order, but blocks of different threads interleave, so readers sort by time.
+#define TRACE_ENV "MY_MALLOC_TRACE" // Starts recording to this file
+#define TRACE_MAGIC "MMUTRACE"
+#define TRACE_VERSION 1
+#define TRACE_BUFFER_RECORDS 1024   // Records a thread buffers before writing them out
+enum { TRACE_MALLOC = 1, TRACE_CALLOC, TRACE_REALLOC, TRACE_FREE, TRACE_MEMALIGN };
+
+// Bump arenas (my_arena_*, separate from the allocator's own arenas) serve objects that all die
+// together: allocation advances a cursor through chunks mapped from the OS, and a reset or rewind just
+// moves the cursor back, keeping the chunks for reuse. Chunk sizes double from the first to the cap.
+#ifndef BUMP_CHUNK_SIZE
+#define BUMP_CHUNK_SIZE (64 * 1024) // Size of an arena's first chunk
+#endif
+#ifndef BUMP_CHUNK_MAX
+#define BUMP_CHUNK_MAX (4 * 1024 * 1024) // Chunk sizes double up to this cap
+#endif
+#define BUMP_ALIGN 16 // Alignment of my_arena_alloc results, enough for any standard type
+
+// mremap is only declared with _GNU_SOURCE, which an including file may not have set; it is called
+// through syscall() instead, so the flag may need defining here
+#ifndef MREMAP_MAYMOVE
+#define MREMAP_MAYMOVE 1
+#endif
+
+// Requests up to SLAB_MAX_SIZE are served from page-sized slabs of equal, header-less objects in
+// SLAB_ALIGN steps. Masking an object's address down to its page finds the slab header. Slabs are carved
+// from map_granule()-sized slab regions whose first page holds a slab_region_t.
+#define SLAB_MAX_SIZE 256
+#define SLAB_ALIGN 16
+#define SLAB_CLASSES (SLAB_MAX_SIZE / SLAB_ALIGN)
+#if SLAB_CLASSES != STATS_SHM_SLAB_CLASSES || SLAB_ALIGN != STATS_SHM_SLAB_ALIGN
+#error "slab classes differ from the stats page in mmu_shm_stats.h"
+#endif
+#define SLAB_PAGE_SIZE 4096
+#define SLAB_BITMAP_WORDS (SLAB_PAGE_SIZE / SLAB_ALIGN / 64)
+#define SLAB_HEADER_SIZE ((sizeof(slab_t) + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1))
+#define SLAB_REGION_PAGES (HUGE_PAGE_SIZE / SLAB_PAGE_SIZE) // Pages in the largest slab region
+
+// Metadata structure for each memory block. Blocks in a mapping are laid out back to back and the
+// mapping ends with a zero-size in-use fence, so physical neighbours are found by address arithmetic.
+// An allocated block carries only its size word; the bin links and the boundary tag (footer: the size
+// again, in the last word) live in the payload of free blocks, where the following block can step back
+// to them without any list walk.
 typedef struct block {
-    size_t size;           // Size of the block
-    int free;              // Free flag: 1 if the block is free, 0 if in use
-    struct block *next;    // Pointer to the next block in the list
-    struct block *prev;    // Pointer to the previous block in the list
+    size_t size;             // Size of the block's payload, with BLOCK_* flags in the low bits
+    struct block *next_free; // Free blocks only: next free block in the same size-class bin
+    struct block *prev_free; // Free blocks only: previous free block in the same size-class bin
+    size_t purged;           // Binned blocks of PURGE_MIN_SIZE or more only: the pages inside were purged
 } block_t;
 
-static block_t *free_list = NULL; // Head of the free list
+// Header at the start of every slab page; the objects follow it
+typedef struct slab {
+    struct slab *next;                            // Next slab in the arena's list for this class (or of empty slabs)
+    struct slab *prev;                            // Previous slab in the arena's list for this class
+    unsigned short obj_size;                      // Size of every object in the slab
+    unsigned short capacity;                      // Number of objects that fit in the page
+    unsigned short used;                          // Number of objects handed out
+    unsigned char arena;                          // Index of the arena owning the slab
+    unsigned long long bitmap[SLAB_BITMAP_WORDS]; // Bit set for every object in use (and past capacity)
+} slab_t;
+
+// Header in the first page of every slab region
+typedef struct slab_region {
+    struct slab_region *next;                                 // Next slab region of the arena
+    size_t live;                                              // Slabs of the region with objects in use
+    size_t purged_count;                                      // Pages given back to the kernel since they emptied
+    unsigned long long purged[SLAB_REGION_PAGES / 64];        // Bit set for every purged page
+} slab_region_t;
+
+// Link stored in the first words of a cached or remotely freed object
+typedef struct tcache_entry {
+    struct tcache_entry *next;
+    uintptr_t key; // tcache_cookie in a thread cache, remote_cookie on a remote-free list; catches double frees
+} tcache_entry;
+
+// Header at the start of every arena chunk
+typedef struct chunk {
+    struct chunk *next; // Next chunk obtained from the system
+    size_t size;        // Length of the chunk's mapping
+} chunk_t;
+
+// An independent heap; every field is protected by lock
+typedef struct arena {
+    pthread_mutex_t lock;
+    block_t *bins[NUM_BINS];                 // Heads of the segregated free lists
+    unsigned long long binmap[BINMAP_WORDS]; // Bit i set when bins[i] is non-empty
+    chunk_t *chunks;                         // Every arena chunk, newest first
+    size_t next_chunk_size;                  // Size of the next chunk to map
+    block_t *top;                            // Unused tail of the newest chunk; free but never binned
+    char *clean;                             // Everything from here to the end of the top block is still zero from the kernel
+    size_t dirty;                            // Bytes freed into large free blocks since the last purge
+    size_t allocated;                        // Payload bytes of blocks and slab objects handed out (thread caches included)
+    size_t counted;                          // Part of allocated that stats.in_use holds, brought up to date on unlock
+    size_t slab_objects[SLAB_CLASSES];       // Slab objects handed out per class
+    size_t slab_capacity[SLAB_CLASSES];      // Objects that fit in the slabs assigned to each class
+    long long dirty_since;                   // When dirty last became non-zero, in milliseconds
+    tcache_entry *remote_free;               // Blocks freed by other arenas' threads; not protected by lock
+    slab_t *slabs[SLAB_CLASSES];             // Slabs with at least one free object, per class
+    slab_t *empty_slabs;                     // Slab pages with no objects in use, ready for any class
+    char *slab_cursor;                       // Next unused page of the newest slab region
+    char *slab_end;                          // End of the newest slab region
+    slab_region_t *slab_regions;             // Every slab region, newest first
+    size_t purged_slabs;                     // Empty slab pages given back to the kernel, reused before fresh ones
+    tcache_entry *remote_slab_free;          // Slab objects freed by other arenas' threads; not protected by lock
+    unsigned char index;                     // Position in arenas[]
+} arena_t;
+
+// Per-thread cache of free objects for the exact size classes; only its owner thread touches it.
+// Bins up to SLAB_MAX_SIZE hold slab objects, the rest hold blocks.
+typedef struct tcache {
+    tcache_entry *entries[NUM_SMALL_BINS];
+    unsigned int counts[NUM_SMALL_BINS];
+    unsigned long long allocations; // my_malloc calls not yet added to the stats page
+    unsigned long long frees;       // my_free calls not yet added to the stats page
+    size_t sample_countdown;        // Bytes left to allocate before the next heap profile sample
+    uint64_t sample_random;         // State of the generator for sampling intervals
+    int in_profiler;                // Set while the profiler runs, so its own allocations are not sampled
+    struct trace_record *trace_buffer; // Records not yet written to the trace file
+    unsigned int trace_count;          // Records in trace_buffer
+    uint32_t trace_thread;             // Thread number in the trace; 0 until the thread records something
+} tcache_t;
+
+// File header of a trace
+typedef struct trace_header {
+    char magic[8];        // TRACE_MAGIC
+    uint32_t version;     // TRACE_VERSION
+    uint32_t record_size; // sizeof(trace_record_t)
+} trace_header_t;
+
+// One recorded call. Pointers identify allocations: an address names one allocation from the call that
+// returned it until the call that frees or reallocates it.
+typedef struct trace_record {
+    uint64_t time_ns; // When the call finished (allocations) or started (frees), since recording started
+    uint64_t size;    // Requested bytes: size, nmemb * size for calloc, the new size for realloc
+    uint64_t ptr;     // Result of malloc, calloc and realloc; argument of free
+    uint64_t old_ptr; // Pointer passed to realloc; the alignment for memalign
+    uint32_t thread;  // Thread number, counting from 1 in order of first call
+    uint8_t op;       // TRACE_MALLOC, TRACE_CALLOC, TRACE_REALLOC, TRACE_FREE or TRACE_MEMALIGN
+    uint8_t pad[3];
+} trace_record_t;
+
+// A live sampled allocation
+typedef struct profile_sample {
+    void *ptr;                    // NULL for an unused slot
+    size_t size;                  // Requested size, after alignment
+    int depth;                    // Frames recorded
+    void *frames[PROFILE_DEPTH];  // Return addresses, innermost first
+} profile_sample_t;
+
+static arena_t arenas[MAX_ARENAS];
+static unsigned int next_arena = 0;                     // Round-robin counter for assigning arenas to threads
+static pthread_once_t arenas_once = PTHREAD_ONCE_INIT;
+static pthread_once_t hooks_once = PTHREAD_ONCE_INIT;
+static pthread_key_t tcache_key;                        // Flushes a thread's cache when the thread exits
+static uintptr_t tcache_cookie;                         // Marks objects that sit in a thread cache
+static uintptr_t remote_cookie;                         // Marks objects that sit on a remote-free list
+static unsigned char *region_map = NULL;                // One byte per REGION_SIZE of address space
+static shm_stats_t *shm_stats = NULL;                   // Shared stats page, if publishing is enabled
+static size_t profile_rate = 0;                         // Mean bytes between samples; 0 while the profiler is off
+static size_t profile_live = 0;                         // Samples currently in profile_table
+static profile_sample_t *profile_table = NULL;          // Open-addressed by pointer; protected by profile_lock
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+static int trace_fd = -1;                               // Trace file while recording, -1 otherwise
+static long long trace_start_ns;                        // Time origin of the trace
+static uint32_t trace_threads = 0;                      // Thread numbers handed out
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER; // Serialises writes of whole buffers
+static int hugepage_mode = HUGEPAGE_MODE;               // HUGEPAGE_OFF, HUGEPAGE_THP or HUGEPAGE_HUGETLB
+
+// Process-wide counters, updated with relaxed atomics only where the allocator talks to the kernel
+static struct {
+    size_t mapped;        // Bytes currently mapped for arena chunks, slab regions and dedicated mappings
+    size_t peak_mapped;   // Largest value mapped has reached
+    size_t direct;        // Payload bytes of blocks with a dedicated mapping
+    size_t in_use;        // Direct bytes plus every arena's allocated as of its last unlock
+    size_t peak_in_use;   // Largest value in_use has reached
+    size_t mmap_calls;
+    size_t munmap_calls;
+    size_t mremap_calls;
+    size_t madvise_calls;
+} stats;
+
+static __thread arena_t *thread_arena_ptr = NULL;       // Arena of the calling thread
+static __thread tcache_t tcache;                        // Cache of the calling thread
+
+// The size word of an in-use block is read without the arena lock by the thread that owns the block,
+// while the arena lock holder may flip its BLOCK_PREV_IN_USE bit, so it is always accessed atomically.
+static size_t load_word(block_t *block) {
+    return __atomic_load_n(&block->size, __ATOMIC_RELAXED);
+}
+
+static void store_word(block_t *block, size_t word) {
+    __atomic_store_n(&block->size, word, __ATOMIC_RELAXED);
+}
+
+// Payload size of a block
+static size_t block_size(block_t *block) {
+    return load_word(block) & ~(size_t)BLOCK_FLAGS;
+}
+
+static int has_flag(block_t *block, size_t flag) {
+    return (load_word(block) & flag) != 0;
+}
+
+static void set_flag(block_t *block, size_t flag) {
+    store_word(block, load_word(block) | flag);
+}
+
+static void clear_flag(block_t *block, size_t flag) {
+    store_word(block, load_word(block) & ~flag);
+}
+
+// Change a block's size, keeping its flags
+static void set_size(block_t *block, size_t size) {
+    store_word(block, size | (load_word(block) & BLOCK_FLAGS));
+}
+
+// Convert between a block and the pointer handed to the user
+static void *block_to_ptr(block_t *block) {
+    return (char *)block + BLOCK_SIZE;
+}
+
+static block_t *ptr_to_block(void *ptr) {
+    return (block_t *)((char *)ptr - BLOCK_SIZE);
+}
+
+// Map a (aligned) block size to its size-class bin
+static size_t bin_index(size_t size) {
+    if (size <= SMALL_BIN_MAX) {
+        return size / ALIGNMENT - 1; // Exact bins: 8, 16, ..., 512
+    }
+    // Log-spaced bins: [513, 1023] -> 64, [1024, 2047] -> 65, ...
+    size_t idx = NUM_SMALL_BINS + (size_t)(63 - __builtin_clzll(size)) - 9;
+    return idx < NUM_BINS ? idx : NUM_BINS - 1;
+}
+
+// Push a free block onto the head of its size-class bin
+static void bin_insert(arena_t *a, block_t *block) {
+    size_t idx = bin_index(block_size(block));
+    block->prev_free = NULL;
+    block->next_free = a->bins[idx];
+    if (a->bins[idx]) a->bins[idx]->prev_free = block;
+    a->bins[idx] = block;
+    a->binmap[idx / 64] |= 1ULL << (idx % 64);
+    if (block_size(block) >= PURGE_MIN_SIZE) block->purged = 0;
+}
 
-// Function to allocate memory from the system using mmap
-static void *allocate_from_system(size_t size) {
-    size_t alloc_size = ALIGN(size + BLOCK_SIZE); // Align the requested size plus block metadata
+// Unlink a free block from its size-class bin
+static void bin_remove(arena_t *a, block_t *block) {
+    size_t idx = bin_index(block_size(block));
+    if (block->prev_free) {
+        block->prev_free->next_free = block->next_free;
+    } else {
+        a->bins[idx] = block->next_free;
+        if (!a->bins[idx]) a->binmap[idx / 64] &= ~(1ULL << (idx % 64));
+    }
+    if (block->next_free) block->next_free->prev_free = block->prev_free;
+}
+
+// Block immediately after this one in memory (the fence if this is the last block of its mapping)
+static block_t *next_block(block_t *block) {
+    return (block_t *)((char *)block_to_ptr(block) + block_size(block));
+}
+
+// Block immediately before this one in memory; only valid when BLOCK_PREV_IN_USE is clear
+static block_t *prev_block(block_t *block) {
+    size_t prev_size = *((size_t *)block - 1); // Footer of the previous block
+    return (block_t *)((char *)block - prev_size - BLOCK_SIZE);
+}
+
+// Write the boundary tag of a free block into the last word of its payload
+static void set_footer(block_t *block) {
+    *(size_t *)((char *)next_block(block) - sizeof(size_t)) = block_size(block);
+}
+
+// Round a length up to a whole number of pages
+static size_t page_align(size_t size) {
+    static size_t page_size = 0; // Threads racing to fill it in all store the same value
+    size_t page = __atomic_load_n(&page_size, __ATOMIC_RELAXED);
+    if (!page) {
+        page = (size_t)sysconf(_SC_PAGESIZE);
+        __atomic_store_n(&page_size, page, __ATOMIC_RELAXED);
+    }
+    return (size + page - 1) & ~(page - 1);
+}
+
+// Count a change in the amount of mapped memory and keep track of its peak
+static void count_mapped(size_t added, size_t removed) {
+    size_t mapped = __atomic_add_fetch(&stats.mapped, added - removed, __ATOMIC_RELAXED);
+    size_t peak = __atomic_load_n(&stats.peak_mapped, __ATOMIC_RELAXED);
+    while (mapped > peak && !__atomic_compare_exchange_n(&stats.peak_mapped, &peak, mapped, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    shm_stats_t *page = __atomic_load_n(&shm_stats, __ATOMIC_ACQUIRE); // May be read outside any arena lock
+    if (page) {
+        __atomic_store_n(&page->mapped, mapped, __ATOMIC_RELAXED);
+        __atomic_store_n(&page->peak_mapped, __atomic_load_n(&stats.peak_mapped, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+        __atomic_store_n(&page->direct_live, __atomic_load_n(&stats.direct, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    }
+}
+
+// Add a change to a counter of the stats page
+static void shm_add(uint64_t *counter, long long delta) {
+    __atomic_fetch_add(counter, (uint64_t)delta, __ATOMIC_RELAXED);
+}
+
+// Count a change in the bytes handed out and keep track of its peak
+static void count_in_use(size_t added, size_t removed) {
+    size_t in_use = __atomic_add_fetch(&stats.in_use, added - removed, __ATOMIC_RELAXED);
+    size_t peak = __atomic_load_n(&stats.peak_in_use, __ATOMIC_RELAXED);
+    while (in_use > peak && !__atomic_compare_exchange_n(&stats.peak_in_use, &peak, in_use, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static void count_call(size_t *counter) {
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+// Unit in which arena chunks and slab regions are mapped and aligned: a region, or a huge page
+static size_t map_granule(void) {
+    return hugepage_mode ? HUGE_PAGE_SIZE : REGION_SIZE;
+}
+
+// Ask for transparent huge pages on a mapping, if they are enabled and it is large enough for one
+static void advise_huge(void *mem, size_t size) {
+    if (!hugepage_mode || size < HUGE_PAGE_SIZE) return;
+    madvise(mem, size, MADV_HUGEPAGE);
+    count_call(&stats.madvise_calls);
+}
+
+// Map size bytes (a multiple of map_granule()) at a map_granule()-aligned address and record in the
+// region map that they belong to the given region map entry
+static void *map_region(size_t size, unsigned char owner) {
+    if (!region_map) return NULL;
+
+    size_t granule = map_granule();
+    char *base = NULL;
+    if (hugepage_mode == HUGEPAGE_HUGETLB) {
+        // Huge pages from the reserved pool come aligned; without enough of them, fall back to THP
+        char *mem = (char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        count_call(&stats.mmap_calls);
+        if (mem != MAP_FAILED) base = mem;
+    }
+    if (!base) {
+        // Over-allocate so an aligned range fits, then give back the misaligned ends
+        char *mem = (char *)mmap(NULL, size + granule, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        count_call(&stats.mmap_calls);
+        if (mem == MAP_FAILED) {
+            return NULL;
+        }
+        base = (char *)(((uintptr_t)mem + granule - 1) & ~(uintptr_t)(granule - 1));
+        if (base > mem) {
+            munmap(mem, (size_t)(base - mem));
+            count_call(&stats.munmap_calls);
+        }
+        if (base + size < mem + size + granule) {
+            munmap(base + size, (size_t)(mem + granule - base));
+            count_call(&stats.munmap_calls);
+        }
+        advise_huge(base, size);
+    }
+    count_mapped(size, 0);
+
+    for (uintptr_t region = (uintptr_t)base >> REGION_SHIFT; region < ((uintptr_t)base + size) >> REGION_SHIFT; region++) {
+        __atomic_store_n(&region_map[region], owner, __ATOMIC_RELAXED);
+    }
+    return base;
+}
+
+// Unmap memory obtained from map_region and clear its region map entries
+static void unmap_region(void *base, size_t size) {
+    for (uintptr_t region = (uintptr_t)base >> REGION_SHIFT; region < ((uintptr_t)base + size) >> REGION_SHIFT; region++) {
+        __atomic_store_n(&region_map[region], 0, __ATOMIC_RELAXED);
+    }
+    count_mapped(0, size);
+    count_call(&stats.munmap_calls);
+    munmap(base, size);
+}
+
+// Region map entry for a pointer: 0 if the allocator's arenas do not own it
+static unsigned char region_owner(const void *ptr) {
+    uintptr_t region = (uintptr_t)ptr >> REGION_SHIFT;
+    if (!region_map || region >> (REGION_ADDRESS_BITS - REGION_SHIFT)) return 0;
+    return __atomic_load_n(&region_map[region], __ATOMIC_RELAXED);
+}
+
+// Start of a block's dedicated mapping: the block itself, unless leading padding put an aligned
+// payload further in, in which case the header sits at the end of the mapping's first page
+static char *mapping_start(block_t *block) {
+    return (char *)((uintptr_t)block & ~(uintptr_t)(page_align(1) - 1));
+}
+
+// Function to allocate memory from the system using mmap; used for requests of MMAP_THRESHOLD or more
+static block_t *allocate_from_system(size_t size) {
+    size_t alloc_size = page_align(size + BLOCK_SIZE); // Block header plus payload, in whole pages
+    if (alloc_size < size) return NULL; // Size overflowed
 
     // Use mmap to request memory from the operating system
-    void *block = mmap(NULL, alloc_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if (block == MAP_FAILED) {
+    void *mem = mmap(NULL, alloc_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    count_call(&stats.mmap_calls);
+    if (mem == MAP_FAILED) {
         return NULL; // Return NULL if mmap fails
     }
+    __atomic_fetch_add(&stats.direct, alloc_size - BLOCK_SIZE, __ATOMIC_RELAXED);
+    count_in_use(alloc_size - BLOCK_SIZE, 0);
+    count_mapped(alloc_size, 0);
+    advise_huge(mem, alloc_size);
+
+    // The whole mapping is one in-use block that goes straight back to the OS when freed
+    block_t *block = (block_t *)mem;
+    store_word(block, (alloc_size - BLOCK_SIZE) | BLOCK_MMAPPED | BLOCK_PREV_IN_USE);
     return block;
 }
 
-// Find a free block in the free list that is large enough for the requested size
-static block_t *find_free_block(block_t **last, size_t size) {
-    block_t *current = free_list;
-    // Traverse the free list to find a suitable block
-    while (current && !(current->free && current->size >= size)) {
-        *last = current;
-        current = current->next;
+// Resize a block's dedicated mapping to hold size bytes, letting the kernel move the pages instead of
+// copying them; returns NULL (leaving the block untouched) if the mapping cannot be resized
+static block_t *remap_from_system(block_t *block, size_t size) {
+    char *start = mapping_start(block);
+    size_t offset = (size_t)((char *)block - start); // Leading padding of an aligned block
+    size_t old_size = offset + BLOCK_SIZE + block_size(block);
+    size_t alloc_size = page_align(offset + size + BLOCK_SIZE);
+    if (alloc_size < size) return NULL; // Size overflowed
+    if (alloc_size == old_size) return block;
+
+    void *mem = (void *)syscall(SYS_mremap, start, old_size, alloc_size, MREMAP_MAYMOVE);
+    count_call(&stats.mremap_calls);
+    if (mem == MAP_FAILED) {
+        return NULL;
     }
-    return current; // Return the found block or NULL if no suitable block was found
+    __atomic_fetch_add(&stats.direct, alloc_size - old_size, __ATOMIC_RELAXED);
+    count_in_use(alloc_size, old_size);
+    count_mapped(alloc_size, old_size);
+    block = (block_t *)((char *)mem + offset);
+    store_word(block, (alloc_size - offset - BLOCK_SIZE) | BLOCK_MMAPPED | BLOCK_PREV_IN_USE);
+    return block;
 }
 
-// Split the block if it's large enough to hold the requested size plus another block
-static void split_block(block_t *block, size_t size) {
-    if (block->size >= size + BLOCK_SIZE + ALIGNMENT) {
-        block_t *new_block = (block_t *)((char *)block + size + BLOCK_SIZE);
-        new_block->size = block->size - size - BLOCK_SIZE; // Update size of the new block
-        new_block->free = 1; // Mark the new block as free
-        new_block->next = block->next;
-        new_block->prev = block;
-        if (block->next) block->next->prev = new_block;
-        block->size = size; // Update size of the current block
-        block->next = new_block; // Link the new block to the list
-    }
-}
-
-// Coalesce adjacent free blocks to avoid fragmentation
-static void coalesce() {
-    block_t *current = free_list;
-    // Traverse the free list and merge adjacent free blocks
-    while (current && current->next) {
-        if (current->free && current->next->free &&
-            (char *)current + current->size + BLOCK_SIZE == (char *)current->next) {
-            current->size += BLOCK_SIZE + current->next->size; // Merge blocks
-            current->next = current->next->next; // Update next pointer
-            if (current->next) {
-                current->next->prev = current; // Update previous pointer of the next block
+// Map a dedicated block whose payload is a multiple of alignment (a power of two above ALIGNMENT).
+// The mapping is over-reserved by the alignment and the unused pages at either end are given back.
+static block_t *allocate_aligned_from_system(size_t alignment, size_t size) {
+    size_t reserve = page_align(alignment + size);
+    if (reserve < size) return NULL; // Size overflowed
+
+    char *mem = (char *)mmap(NULL, reserve, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    count_call(&stats.mmap_calls);
+    if (mem == MAP_FAILED) {
+        return NULL;
+    }
+    char *payload = (char *)(((uintptr_t)mem + BLOCK_SIZE + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    block_t *block = ptr_to_block(payload);
+    char *start = mapping_start(block);
+    char *end = mem + page_align((size_t)(payload + size - mem));
+    if (start > mem) {
+        munmap(mem, (size_t)(start - mem));
+        count_call(&stats.munmap_calls);
+    }
+    if (end < mem + reserve) {
+        munmap(end, (size_t)(mem + reserve - end));
+        count_call(&stats.munmap_calls);
+    }
+    __atomic_fetch_add(&stats.direct, (size_t)(end - payload), __ATOMIC_RELAXED);
+    count_in_use((size_t)(end - payload), 0);
+    count_mapped((size_t)(end - start), 0);
+    advise_huge(start, (size_t)(end - start));
+
+    store_word(block, (size_t)(end - payload) | BLOCK_MMAPPED | BLOCK_PREV_IN_USE);
+    return block;
+}
+
+// Map a new arena chunk big enough for size bytes and make its space the new top block.
+// The previous top, if any, is handed to the bins so its space is not lost.
+static int grow_arena(arena_t *a, size_t size) {
+    size_t need = size + sizeof(chunk_t) + 2 * BLOCK_SIZE;
+    size_t chunk_size = (a->next_chunk_size + map_granule() - 1) & ~(map_granule() - 1);
+    while (chunk_size < need) chunk_size *= 2;
+    if (a->next_chunk_size < ARENA_CHUNK_MAX) a->next_chunk_size *= 2; // Grow geometrically
+
+    chunk_t *chunk = (chunk_t *)map_region(chunk_size, (unsigned char)(a->index + 1));
+    if (!chunk) {
+        return 0;
+    }
+    chunk->size = chunk_size;
+    chunk->next = a->chunks;
+    a->chunks = chunk;
+
+    if (a->top) {
+        set_footer(a->top); // The retired top is already free; its fence knows that
+        bin_insert(a, a->top);
+    }
+
+    // The chunk is one free block followed by a zero-size in-use fence
+    block_t *top = (block_t *)(chunk + 1);
+    store_word(top, (chunk_size - sizeof(chunk_t) - 2 * BLOCK_SIZE) | BLOCK_FREE | BLOCK_PREV_IN_USE);
+    store_word(next_block(top), 0);
+    a->top = top;
+    a->clean = (char *)block_to_ptr(top);
+    return 1;
+}
+
+// Make a block that starts further into the chunk than the old top the new top. Only the bytes below
+// its payload have been written, so the part of the chunk known to be zero shrinks to that payload.
+static void advance_top(arena_t *a, block_t *top) {
+    a->top = top;
+    if ((char *)block_to_ptr(top) > a->clean) a->clean = (char *)block_to_ptr(top);
+}
+
+// Carve an in-use block of the given size off the front of the top block, growing the arena if needed.
+// If dirty is not NULL it receives how many leading bytes of the payload may be non-zero.
+static block_t *carve_from_top(arena_t *a, size_t size, size_t *dirty) {
+    if (!a->top || block_size(a->top) < size) {
+        if (!grow_arena(a, size)) return NULL;
+    }
+
+    block_t *block = a->top;
+    if (dirty) {
+        char *ptr = (char *)block_to_ptr(block);
+        *dirty = ptr >= a->clean ? 0 : (size_t)(a->clean - ptr) < size ? (size_t)(a->clean - ptr) : size;
+    }
+    size_t total = block_size(block);
+    if (total >= size + BLOCK_SIZE + MIN_PAYLOAD) {
+        // The rest of the chunk stays the top
+        store_word(block, size | BLOCK_PREV_IN_USE);
+        block_t *top = next_block(block);
+        store_word(top, (total - size - BLOCK_SIZE) | BLOCK_FREE | BLOCK_PREV_IN_USE);
+        advance_top(a, top);
+    } else {
+        a->top = NULL; // Not enough left for another block; the chunk is used up
+        clear_flag(block, BLOCK_FREE);
+        set_flag(next_block(block), BLOCK_PREV_IN_USE);
+    }
+    a->allocated += block_size(block);
+    return block;
+}
+
+// Find a free block that is large enough for the requested size and unlink it from its bin. At most
+// limit blocks of the size's own log-spaced bin are tried, so a bin full of blocks slightly too small
+// does not make every search walk all of them.
+static block_t *find_free_block(arena_t *a, size_t size, size_t limit) {
+    size_t idx = bin_index(size);
+    block_t *current = a->bins[idx];
+
+    if (size <= SMALL_BIN_MAX) {
+        // Every block in an exact bin has exactly the requested size
+        if (current) {
+            bin_remove(a, current);
+            return current;
+        }
+    } else {
+        // A log-spaced bin mixes sizes, so first-fit within it
+        for (size_t tried = 0; current && tried < limit; tried++, current = current->next_free) {
+            if (block_size(current) >= size) {
+                bin_remove(a, current);
+                return current;
             }
+        }
+    }
+
+    // Any block in a higher non-empty bin is large enough; use the bitmap to skip empty bins
+    for (size_t i = idx + 1; i < NUM_BINS; ) {
+        unsigned long long word = a->binmap[i / 64] & (~0ULL << (i % 64));
+        if (word) {
+            current = a->bins[(i & ~(size_t)63) + (size_t)__builtin_ctzll(word)];
+            bin_remove(a, current);
+            return current;
+        }
+        i = (i & ~(size_t)63) + 64;
+    }
+    return NULL; // No suitable block was found
+}
+
+// Merge a free block with its free physical neighbours; returns the start of the merged block.
+// Only the two neighbours are inspected, so this is constant time regardless of heap size.
+// A block that merges with the top block becomes the new top instead of going into a bin.
+static block_t *coalesce(arena_t *a, block_t *block) {
+    block_t *next = next_block(block);
+    int into_top = next == a->top;
+    if (has_flag(next, BLOCK_FREE)) {
+        if (!into_top) bin_remove(a, next);
+        set_size(block, block_size(block) + BLOCK_SIZE + block_size(next)); // Absorb the following block
+    }
+    if (!has_flag(block, BLOCK_PREV_IN_USE)) {
+        block_t *prev = prev_block(block);
+        bin_remove(a, prev);
+        set_size(prev, block_size(prev) + BLOCK_SIZE + block_size(block)); // Let the previous block absorb this one
+        block = prev;
+    }
+    if (into_top) a->top = block;
+    return block;
+}
+
+// Monotonic clock in milliseconds, for the purge delay
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+// Record that size bytes were freed into a block large enough to be purged
+static void note_dirty(arena_t *a, size_t size) {
+    if (PURGE_DECAY_MS < 0) return;
+    if (!a->dirty) a->dirty_since = now_ms();
+    a->dirty += size;
+}
+
+// Hand a free block back: merge it with its neighbours, then tag it and put it in its size-class bin
+static void release_block(arena_t *a, block_t *block) {
+    size_t size = block_size(block);
+    a->allocated -= size;
+    set_flag(block, BLOCK_FREE);
+    block = coalesce(a, block);
+    if (block_size(block) >= PURGE_MIN_SIZE) note_dirty(a, size);
+    if (block == a->top) return; // Merged into the top block, which is never binned
+
+    set_footer(block);
+    clear_flag(next_block(block), BLOCK_PREV_IN_USE);
+    bin_insert(a, block);
+}
+
+// Split the block if it's large enough to hold the requested size plus another block
+static void split_block(arena_t *a, block_t *block, size_t size) {
+    if (has_flag(block, BLOCK_MMAPPED)) return; // A dedicated mapping is unmapped as a whole, so it is never split
+    if (size < MIN_PAYLOAD) size = MIN_PAYLOAD; // The block must be able to hold its links once freed
+    size_t total = block_size(block);
+    if (total >= size + BLOCK_SIZE + MIN_PAYLOAD) {
+        set_size(block, size); // Update size of the current block
+        block_t *new_block = next_block(block);
+        store_word(new_block, (total - size - BLOCK_SIZE) | BLOCK_PREV_IN_USE); // The block being split stays in use
+        a->allocated -= total - size - block_size(new_block); // The remainder counts as in use until it is released
+        release_block(a, new_block); // Make the remainder available to later allocations
+    }
+}
+
+// Grow an in-use block to size bytes by absorbing the free block after it, if that is large enough.
+// Called with the arena lock held; returns 0 if the block could not grow in place.
+static int grow_in_place(arena_t *a, block_t *block, size_t size) {
+    block_t *next = next_block(block);
+    if (!has_flag(next, BLOCK_FREE)) return 0;
+    size_t total = block_size(block) + BLOCK_SIZE + block_size(next);
+    if (total < size) return 0;
+
+    if (next == a->top) {
+        if (total >= size + BLOCK_SIZE + MIN_PAYLOAD) {
+            // Move the start of the top block up past the grown block
+            a->allocated += size - block_size(block);
+            set_size(block, size);
+            block_t *top = next_block(block);
+            store_word(top, (total - size - BLOCK_SIZE) | BLOCK_FREE | BLOCK_PREV_IN_USE);
+            advance_top(a, top);
+            return 1;
+        }
+        a->top = NULL; // Not enough would be left for a top block; take the rest of the chunk
+    } else {
+        bin_remove(a, next);
+    }
+    a->allocated += total - block_size(block);
+    set_size(block, total);
+    set_flag(next_block(block), BLOCK_PREV_IN_USE);
+    split_block(a, block, size); // Give back whatever is beyond the requested size
+    return 1;
+}
+
+// Allocate a block from an arena whose lock is held by the caller.
+// If dirty is not NULL it receives how many leading bytes of the payload may be non-zero.
+static block_t *arena_alloc(arena_t *a, size_t size, size_t *dirty) {
+    block_t *block = find_free_block(a, size, FIT_SEARCH_LIMIT);
+    if (!block && size > SMALL_BIN_MAX && (!a->top || block_size(a->top) < size)) {
+        // The arena would have to grow: worth trying every block of the size's bin first
+        block = find_free_block(a, size, SIZE_MAX);
+    }
+    if (block) {
+        if (dirty) *dirty = size; // Recycled memory holds old data
+        // Reuse a free block from the size-class bins
+        clear_flag(block, BLOCK_FREE); // Mark the block as in use
+        a->allocated += block_size(block);
+        set_flag(next_block(block), BLOCK_PREV_IN_USE);
+        split_block(a, block, size); // Split the block if necessary
+        return block;
+    }
+    return carve_from_top(a, size, dirty); // Carve a new block out of the arena
+}
+
+// Allocate a block whose payload is a multiple of alignment (a power of two above ALIGNMENT).
+// A larger block is taken and the padding before the aligned payload is split off and freed, so
+// it stays usable; it must be big enough to stand as a free block of its own.
+static block_t *arena_alloc_aligned(arena_t *a, size_t alignment, size_t size) {
+    block_t *block = arena_alloc(a, size + alignment + BLOCK_SIZE + MIN_PAYLOAD, NULL);
+    if (!block) return NULL;
+
+    uintptr_t payload = (uintptr_t)block_to_ptr(block);
+    if (payload & (alignment - 1)) {
+        uintptr_t aligned = (payload + BLOCK_SIZE + MIN_PAYLOAD + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        block_t *lead = block;
+        size_t total = block_size(lead);
+        block = ptr_to_block((void *)aligned);
+        set_size(lead, (size_t)((char *)block - (char *)payload));
+        store_word(block, (total - block_size(lead) - BLOCK_SIZE) | BLOCK_PREV_IN_USE);
+        a->allocated -= BLOCK_SIZE; // The new header came out of the block; release_block drops the rest of lead
+        release_block(a, lead);
+    }
+    split_block(a, block, size); // Give back what is left after the payload
+    return block;
+}
+
+// Unit in which memory is purged: a page, or a whole huge page so that purging never splits one
+static size_t purge_unit(void) {
+    return hugepage_mode ? HUGE_PAGE_SIZE : page_align(1);
+}
+
+// Give the whole purge units in [start, end) back to the kernel; returns whether anything was purged
+static int purge_range(char *start, char *end) {
+    size_t unit = purge_unit();
+    start = (char *)(((uintptr_t)start + unit - 1) & ~(uintptr_t)(unit - 1));
+    end = (char *)((uintptr_t)end & ~(uintptr_t)(unit - 1));
+    if (end <= start) return 0;
+    madvise(start, (size_t)(end - start), PURGE_ADVICE);
+    count_call(&stats.madvise_calls);
+    return 1;
+}
+
+// Unmap the chunk a free block spans entirely, if it does; the block must not be the top
+static int unmap_if_whole_chunk(arena_t *a, block_t *block) {
+    chunk_t **link = &a->chunks;
+    while (*link && (char *)(*link + 1) != (char *)block) link = &(*link)->next;
+    chunk_t *chunk = *link;
+    if (!chunk || block_size(block) != chunk->size - sizeof(chunk_t) - 2 * BLOCK_SIZE) return 0;
+
+    bin_remove(a, block);
+    *link = chunk->next;
+    unmap_region(chunk, chunk->size);
+    return 1;
+}
+
+// Slab region a slab page belongs to
+static slab_region_t *region_of_slab(slab_t *slab) {
+    return (slab_region_t *)((uintptr_t)slab & ~(uintptr_t)(map_granule() - 1));
+}
+
+// Give empty slab pages back to the kernel, and unmap the slab regions with no live slab left
+static void purge_slabs(arena_t *a) {
+    // Pages freed in address order sit next to each other on the list, so neighbours are purged in one call
+    char *run_start = NULL, *run_end = NULL;
+    slab_t **link = &a->empty_slabs;
+    while (*link) {
+        slab_t *slab = *link;
+        slab_region_t *r = region_of_slab(slab);
+        if (r->live && purge_unit() > SLAB_PAGE_SIZE) {
+            // A slab region is one huge page: its empty pages stay until the whole region can go
+            link = &slab->next;
+            continue;
+        }
+        *link = slab->next; // Pages of regions about to be unmapped just leave the list
+        if (!r->live) continue;
+
+        // Remember the page as purged so new_slab can hand it out again
+        size_t page = (size_t)((char *)slab - (char *)r) / SLAB_PAGE_SIZE;
+        r->purged[page / 64] |= 1ULL << (page % 64);
+        r->purged_count++;
+        a->purged_slabs++;
+        if ((char *)slab == run_end) {
+            run_end += SLAB_PAGE_SIZE;
+        } else if ((char *)slab + SLAB_PAGE_SIZE == run_start) {
+            run_start = (char *)slab;
         } else {
-            current = current->next; // Move to the next block
+            if (run_start) purge_range(run_start, run_end);
+            run_start = (char *)slab;
+            run_end = run_start + SLAB_PAGE_SIZE;
+        }
+    }
+    if (run_start) purge_range(run_start, run_end);
+
+    size_t granule = map_granule();
+    slab_region_t **region_link = &a->slab_regions;
+    while (*region_link) {
+        slab_region_t *r = *region_link;
+        if (r->live) {
+            region_link = &r->next;
+            continue;
         }
+        *region_link = r->next;
+        a->purged_slabs -= r->purged_count;
+        if (a->slab_cursor > (char *)r && a->slab_cursor <= (char *)r + granule) a->slab_cursor = a->slab_end = NULL;
+        unmap_region(r, granule);
     }
 }
 
-// Custom malloc function to allocate memory
-void *my_malloc(size_t size) {
+// Purged slab page to reuse; the arena must have one
+static slab_t *take_purged_slab(arena_t *a) {
+    slab_region_t *r = a->slab_regions;
+    while (!r->purged_count) r = r->next;
+    size_t w = 0;
+    while (!r->purged[w]) w++;
+    size_t bit = (size_t)__builtin_ctzll(r->purged[w]);
+    r->purged[w] &= ~(1ULL << bit);
+    r->purged_count--;
+    a->purged_slabs--;
+    return (slab_t *)((char *)r + (w * 64 + bit) * SLAB_PAGE_SIZE);
+}
+
+// Purge every large free block of an arena whose lock is held by the caller
+static void purge_arena(arena_t *a) {
+    a->dirty = 0;
+    for (size_t idx = bin_index(PURGE_MIN_SIZE); idx < NUM_BINS; idx++) {
+        block_t *block = a->bins[idx];
+        while (block) {
+            block_t *next = block->next_free;
+            if (block_size(block) >= PURGE_MIN_SIZE && !block->purged && !unmap_if_whole_chunk(a, block)) {
+                // Keep the unit holding the links; the footer's unit is excluded by rounding down
+                purge_range((char *)&block->purged + sizeof(size_t), (char *)next_block(block) - sizeof(size_t));
+                block->purged = 1;
+            }
+            block = next;
+        }
+    }
+    purge_slabs(a);
+
+    // The top block has no links, so everything after its header can go; it reads as zero afterwards
+    if (a->top) {
+        char *start = (char *)block_to_ptr(a->top);
+        char *end = (char *)next_block(a->top);
+        size_t unit = purge_unit();
+        char *first_unit = (char *)(((uintptr_t)start + unit - 1) & ~(uintptr_t)(unit - 1));
+        if (a->clean > first_unit && purge_range(start, end) && a->clean <= (char *)((uintptr_t)end & ~(uintptr_t)(unit - 1))) {
+            a->clean = first_unit;
+        }
+    }
+}
+
+// Purge the arena if memory has been waiting for longer than the decay delay; the arena lock is held
+static void maybe_purge(arena_t *a) {
+    if (!a->dirty) return;
+    if (PURGE_DECAY_MS > 0 && now_ms() - a->dirty_since < PURGE_DECAY_MS) return;
+    purge_arena(a);
+}
+
+// Slab header of a slab object, found by masking the pointer down to its page
+static slab_t *slab_of(const void *ptr) {
+    return (slab_t *)((uintptr_t)ptr & ~(uintptr_t)(SLAB_PAGE_SIZE - 1));
+}
+
+// Set up a fresh slab for a size class and put it at the head of the arena's list for that class
+static slab_t *new_slab(arena_t *a, size_t cls) {
+    slab_t *slab = a->empty_slabs;
+    if (slab) {
+        a->empty_slabs = slab->next;
+    } else if (a->purged_slabs) {
+        slab = take_purged_slab(a);
+    } else {
+        if (a->slab_cursor == a->slab_end) {
+            char *region = (char *)map_region(map_granule(), (unsigned char)(REGION_SLAB | (a->index + 1)));
+            if (!region) return NULL;
+            slab_region_t *r = (slab_region_t *)region; // Zero from the kernel: no live or purged pages
+            r->next = a->slab_regions;
+            a->slab_regions = r;
+            a->slab_cursor = region + SLAB_PAGE_SIZE; // The first page holds the region header
+            a->slab_end = region + map_granule();
+        }
+        slab = (slab_t *)a->slab_cursor;
+        a->slab_cursor += SLAB_PAGE_SIZE;
+    }
+    region_of_slab(slab)->live++;
+
+    slab->obj_size = (unsigned short)((cls + 1) * SLAB_ALIGN);
+    slab->capacity = (unsigned short)((SLAB_PAGE_SIZE - SLAB_HEADER_SIZE) / slab->obj_size);
+    slab->used = 0;
+    slab->arena = a->index;
+    a->slab_capacity[cls] += slab->capacity;
+    if (shm_stats) shm_add(&shm_stats->slab_capacity[cls], slab->capacity);
+    for (size_t w = 0; w < SLAB_BITMAP_WORDS; w++) {
+        // Bits past the capacity are permanently set so the search never hands them out
+        size_t first = w * 64;
+        if (first >= slab->capacity) slab->bitmap[w] = ~0ULL;
+        else if (slab->capacity - first >= 64) slab->bitmap[w] = 0;
+        else slab->bitmap[w] = ~0ULL << (slab->capacity - first);
+    }
+
+    slab->prev = NULL;
+    slab->next = a->slabs[cls];
+    if (slab->next) slab->next->prev = slab;
+    a->slabs[cls] = slab;
+    return slab;
+}
+
+// Unlink a slab from its class list (it became full, or empty)
+static void slab_unlink(arena_t *a, slab_t *slab) {
+    size_t cls = slab->obj_size / SLAB_ALIGN - 1;
+    if (slab->prev) slab->prev->next = slab->next;
+    else a->slabs[cls] = slab->next;
+    if (slab->next) slab->next->prev = slab->prev;
+}
+
+// Hand out one object of the class from an arena whose lock is held by the caller
+static void *slab_alloc(arena_t *a, size_t cls) {
+    slab_t *slab = a->slabs[cls];
+    if (!slab && !(slab = new_slab(a, cls))) return NULL;
+
+    for (size_t w = 0; w < SLAB_BITMAP_WORDS; w++) {
+        unsigned long long word = ~slab->bitmap[w];
+        if (word) {
+            size_t bit = (size_t)__builtin_ctzll(word);
+            slab->bitmap[w] |= 1ULL << bit;
+            if (++slab->used == slab->capacity) slab_unlink(a, slab); // Full slabs leave the list
+            a->allocated += slab->obj_size;
+            a->slab_objects[cls]++;
+            if (shm_stats) shm_add(&shm_stats->slab_objects[cls], 1);
+            return (char *)slab + SLAB_HEADER_SIZE + (w * 64 + bit) * slab->obj_size;
+        }
+    }
+    return NULL; // Not reached: listed slabs always have a free object
+}
+
+// Return an object to its slab in an arena whose lock is held by the caller
+static void slab_free(arena_t *a, void *ptr) {
+    slab_t *slab = slab_of(ptr);
+    size_t i = (size_t)((char *)ptr - ((char *)slab + SLAB_HEADER_SIZE)) / slab->obj_size;
+    unsigned long long bit = 1ULL << (i % 64);
+    if (!(slab->bitmap[i / 64] & bit)) return; // Already free: ignore the double free
+
+    size_t cls = slab->obj_size / SLAB_ALIGN - 1;
+    a->allocated -= slab->obj_size;
+    a->slab_objects[cls]--;
+    if (shm_stats) shm_add(&shm_stats->slab_objects[cls], -1);
+    slab->bitmap[i / 64] &= ~bit;
+    if (slab->used-- == slab->capacity) {
+        // A full slab has room again; put it back on its class list
+        slab->prev = NULL;
+        slab->next = a->slabs[cls];
+        if (slab->next) slab->next->prev = slab;
+        a->slabs[cls] = slab;
+    }
+    if (slab->used == 0) {
+        // Keep the empty page for whichever class needs a slab next
+        slab_unlink(a, slab);
+        a->slab_capacity[cls] -= slab->capacity;
+        if (shm_stats) shm_add(&shm_stats->slab_capacity[cls], -(long long)slab->capacity);
+        slab->next = a->empty_slabs;
+        a->empty_slabs = slab;
+        region_of_slab(slab)->live--;
+        note_dirty(a, SLAB_PAGE_SIZE);
+    }
+}
+
+// Push an object onto another arena's remote-free list (multi-producer, lock-free)
+static void remote_push(tcache_entry **list, void *ptr) {
+    tcache_entry *entry = (tcache_entry *)ptr;
+    entry->key = remote_cookie; // Keeps a repeated free of the same pointer from queueing it twice
+    tcache_entry *head = __atomic_load_n(list, __ATOMIC_RELAXED);
+    do {
+        entry->next = head;
+    } while (!__atomic_compare_exchange_n(list, &head, entry, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+// Whether an object sits on a remote-free list already. Blocks too large for the thread cache are not
+// checked by already_cached, so a repeated free from another thread would otherwise queue them twice.
+static int remote_queued(void *ptr) {
+    return ((tcache_entry *)ptr)->key == remote_cookie;
+}
+
+// Lock an arena and merge back every object other threads have queued for it since the last time
+static void arena_lock(arena_t *a) {
+    pthread_mutex_lock(&a->lock);
+
+    // A single exchange takes a whole list, so the consumer never races with pushers
+    if (__atomic_load_n(&a->remote_free, __ATOMIC_RELAXED)) {
+        tcache_entry *entry = __atomic_exchange_n(&a->remote_free, NULL, __ATOMIC_ACQUIRE);
+        while (entry) {
+            tcache_entry *next = entry->next;
+            entry->key = 0; // The block may be merged away; leave no stale cookie behind
+            release_block(a, ptr_to_block(entry));
+            entry = next;
+        }
+    }
+    if (__atomic_load_n(&a->remote_slab_free, __ATOMIC_RELAXED)) {
+        tcache_entry *entry = __atomic_exchange_n(&a->remote_slab_free, NULL, __ATOMIC_ACQUIRE);
+        while (entry) {
+            tcache_entry *next = entry->next;
+            entry->key = 0;
+            slab_free(a, entry);
+            entry = next;
+        }
+    }
+    maybe_purge(a);
+}
+
+// Add the calling thread's call counts to the stats page
+static void publish_thread_counts(void) {
+    shm_stats_t *page = __atomic_load_n(&shm_stats, __ATOMIC_ACQUIRE); // May be read outside any arena lock
+    if (!page) return;
+    __atomic_fetch_add(&page->allocations, tcache.allocations, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&page->frees, tcache.frees, __ATOMIC_RELAXED);
+    tcache.allocations = tcache.frees = 0;
+}
+
+// Unlock an arena, first counting the change in its usage and publishing this thread's call counts and
+// the arena's usage to the stats page
+static void arena_unlock(arena_t *a) {
+    if (a->allocated != a->counted) {
+        count_in_use(a->allocated, a->counted);
+        a->counted = a->allocated;
+    }
+    if (shm_stats) {
+        publish_thread_counts();
+        __atomic_store_n(&shm_stats->arena_live[a->index], a->allocated, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&a->lock);
+}
+
+// Whether a thread-cache bin holds slab objects rather than blocks
+static int tcache_holds_slabs(size_t idx) {
+    return (idx + 1) * ALIGNMENT <= SLAB_MAX_SIZE;
+}
+
+// Pop an object from a non-empty thread-cache bin
+static void *tcache_pop(size_t idx) {
+    tcache_entry *entry = tcache.entries[idx];
+    tcache.entries[idx] = entry->next;
+    tcache.counts[idx]--;
+    entry->key = 0;
+    return entry;
+}
+
+// Push an object onto a thread-cache bin with room left
+static void tcache_push(size_t idx, void *ptr) {
+    tcache_entry *entry = (tcache_entry *)ptr;
+    entry->key = tcache_cookie;
+    entry->next = tcache.entries[idx];
+    tcache.entries[idx] = entry;
+    tcache.counts[idx]++;
+}
+
+// Whether a freed object is already in a thread cache or a remote-free list
+static int already_cached(size_t idx, void *ptr) {
+    tcache_entry *entry = (tcache_entry *)ptr;
+    if (entry->key == remote_cookie) return 1;
+    if (entry->key != tcache_cookie) return 0;
+    // Probably already cached; confirm before ignoring the free
+    for (tcache_entry *e = tcache.entries[idx]; e; e = e->next) {
+        if (e == entry) return 1;
+    }
+    return 0;
+}
+
+// Give the first count objects of a thread-cache bin back: objects of this thread's arena are released
+// under one lock, objects of other arenas go onto their remote-free lists without locking them
+static void tcache_flush(size_t idx, unsigned int count) {
+    arena_t *own = thread_arena_ptr;
+    int slabs = tcache_holds_slabs(idx);
+    int locked = 0;
+    while (count-- && tcache.entries[idx]) {
+        void *ptr = tcache_pop(idx);
+
+        arena_t *a = &arenas[(region_owner(ptr) & ~REGION_SLAB) - 1];
+        if (a != own) {
+            remote_push(slabs ? &a->remote_slab_free : &a->remote_free, ptr);
+            continue;
+        }
+        if (!locked) {
+            arena_lock(own);
+            locked = 1;
+        }
+        if (slabs) slab_free(own, ptr);
+        else release_block(own, ptr_to_block(ptr));
+    }
+    if (locked) arena_unlock(own);
+}
+
+// Monotonic clock in nanoseconds, for trace timestamps
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Write the calling thread's buffered trace records to the trace file
+static void trace_flush(void) {
+    if (!tcache.trace_count) return;
+    pthread_mutex_lock(&trace_lock);
+    int fd = __atomic_load_n(&trace_fd, __ATOMIC_RELAXED);
+    if (fd >= 0) {
+        const char *data = (const char *)tcache.trace_buffer;
+        size_t left = tcache.trace_count * sizeof(trace_record_t);
+        while (left) {
+            ssize_t n = write(fd, data, left);
+            if (n <= 0) break;
+            data += n;
+            left -= (size_t)n;
+        }
+    }
+    pthread_mutex_unlock(&trace_lock);
+    tcache.trace_count = 0;
+}
+
+// Thread-exit destructor: return every cached block so it is not stranded
+static void tcache_destroy(void *unused) {
+    (void)unused;
+    for (size_t idx = 0; idx < NUM_SMALL_BINS; idx++) {
+        tcache_flush(idx, TCACHE_COUNT);
+    }
+    publish_thread_counts();
+    if (tcache.trace_buffer) {
+        trace_flush();
+        munmap(tcache.trace_buffer, TRACE_BUFFER_RECORDS * sizeof(trace_record_t));
+        tcache.trace_buffer = NULL;
+    }
+}
+
+// Create (or reuse) the stats page, fill it from the current state and start publishing to it.
+// name is a file under /dev/shm, or an absolute path.
+static int open_stats_shm(const char *name) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s%s", name[0] == '/' ? "" : "/dev/shm/", name);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return -1;
+    if (ftruncate(fd, (off_t)sizeof(shm_stats_t)) != 0) {
+        close(fd);
+        return -1;
+    }
+    void *page = mmap(NULL, sizeof(shm_stats_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) return -1;
+
+    shm_stats_t *page_stats = (shm_stats_t *)page;
+    memset(page_stats, 0, sizeof(shm_stats_t));
+    page_stats->version = STATS_SHM_VERSION;
+    page_stats->pid = (int32_t)getpid();
+    page_stats->arenas = MAX_ARENAS;
+
+    // With every arena locked the arena counters cannot change, so the page starts out consistent and
+    // later changes only need to be added to it
+    for (unsigned int i = 0; i < MAX_ARENAS; i++) pthread_mutex_lock(&arenas[i].lock);
+    for (unsigned int i = 0; i < MAX_ARENAS; i++) {
+        page_stats->arena_live[i] = arenas[i].allocated;
+        for (size_t cls = 0; cls < SLAB_CLASSES; cls++) {
+            page_stats->slab_objects[cls] += arenas[i].slab_objects[cls];
+            page_stats->slab_capacity[cls] += arenas[i].slab_capacity[cls];
+        }
+    }
+    __atomic_store_n(&shm_stats, page_stats, __ATOMIC_RELEASE);
+    for (unsigned int i = 0; i < MAX_ARENAS; i++) pthread_mutex_unlock(&arenas[i].lock);
+
+    count_mapped(0, 0); // Copies the mapping counters
+    __atomic_store_n(&page_stats->magic, STATS_SHM_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// Set up the sample table and start sampling about once per rate bytes
+static int start_profile(size_t rate) {
+    pthread_mutex_lock(&profile_lock);
+    if (!profile_table) {
+        void *table = mmap(NULL, PROFILE_MAX_SAMPLES * sizeof(profile_sample_t), PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (table == MAP_FAILED) {
+            pthread_mutex_unlock(&profile_lock);
+            return -1;
+        }
+        profile_table = (profile_sample_t *)table;
+    }
+    pthread_mutex_unlock(&profile_lock);
+
+    // The first backtrace loads the unwinder, which allocates; do it before sampling can recurse
+    void *frame;
+    tcache.in_profiler = 1;
+    backtrace(&frame, 1);
+    tcache.in_profiler = 0;
+    __atomic_store_n(&profile_rate, rate, __ATOMIC_RELAXED);
+    return 0;
+}
+
+// Write the last records of the thread that ends the process
+static void trace_at_exit(void) {
+    trace_flush();
+}
+
+// Create the trace file and start recording to it
+static int start_trace(const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    trace_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.record_size = sizeof(trace_record_t);
+    if (write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header)) {
+        close(fd);
+        return -1;
+    }
+
+    static int exit_hook = 0;
+    if (!exit_hook) {
+        exit_hook = 1;
+        atexit(trace_at_exit);
+    }
+    trace_start_ns = now_ns();
+    __atomic_store_n(&trace_fd, fd, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static void init_arenas(void) {
+    for (unsigned int i = 0; i < MAX_ARENAS; i++) {
+        pthread_mutex_init(&arenas[i].lock, NULL);
+        arenas[i].next_chunk_size = ARENA_CHUNK_SIZE;
+        arenas[i].index = (unsigned char)i;
+    }
+    pthread_key_create(&tcache_key, tcache_destroy);
+    tcache_cookie = ((uintptr_t)&tcache_cookie * 0x9E3779B97F4A7C15ULL) ^ (uintptr_t)getpid();
+    remote_cookie = ~tcache_cookie;
+
+    // Read before the first chunk is mapped; getenv does not allocate
+    char *hugepage_env = getenv(HUGEPAGE_ENV);
+    if (hugepage_env) {
+        if (!strcmp(hugepage_env, "thp")) hugepage_mode = HUGEPAGE_THP;
+        else if (!strcmp(hugepage_env, "hugetlb")) hugepage_mode = HUGEPAGE_HUGETLB;
+        else if (!strcmp(hugepage_env, "off")) hugepage_mode = HUGEPAGE_OFF;
+    }
+
+    // Reserve the region map; only the pages covering regions actually used ever become resident
+    void *map = mmap(NULL, 1UL << (REGION_ADDRESS_BITS - REGION_SHIFT), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (map != MAP_FAILED) region_map = (unsigned char *)map;
+}
+
+// Around fork every allocator lock is taken, so the child never inherits one held by a thread it lacks
+static void prefork(void) {
+    pthread_mutex_lock(&profile_lock);
+    pthread_mutex_lock(&trace_lock);
+    for (unsigned int i = 0; i < MAX_ARENAS; i++) {
+        pthread_mutex_lock(&arenas[i].lock);
+    }
+}
+
+static void postfork(void) {
+    for (unsigned int i = 0; i < MAX_ARENAS; i++) {
+        pthread_mutex_unlock(&arenas[i].lock);
+    }
+    pthread_mutex_unlock(&trace_lock);
+    pthread_mutex_unlock(&profile_lock);
+}
+
+// Setup that may itself allocate, run once the first thread has an arena so the allocation can be served
+static void init_hooks(void) {
+    pthread_atfork(prefork, postfork, postfork);
+    char *stats_name = getenv(STATS_SHM_ENV);
+    if (stats_name && *stats_name) open_stats_shm(stats_name);
+    char *profile_env = getenv(PROFILE_ENV);
+    if (profile_env && atol(profile_env) > 0) start_profile((size_t)atol(profile_env));
+    char *trace_path = getenv(TRACE_ENV);
+    if (trace_path && *trace_path) start_trace(trace_path);
+}
+
+// Arena of the calling thread, assigned round-robin on the thread's first allocation
+static arena_t *thread_arena(void) {
+    if (!thread_arena_ptr) {
+        pthread_once(&arenas_once, init_arenas);
+        unsigned int idx = __atomic_fetch_add(&next_arena, 1, __ATOMIC_RELAXED) % MAX_ARENAS;
+        thread_arena_ptr = &arenas[idx];
+        pthread_setspecific(tcache_key, &tcache); // Any non-NULL value arms the exit destructor
+        pthread_once(&hooks_once, init_hooks);
+    }
+    return thread_arena_ptr;
+}
+
+// Append a record to the calling thread's trace buffer
+static void trace_record(uint8_t op, size_t size, void *ptr, void *old_ptr) {
+    if (!tcache.trace_buffer) {
+        void *buffer = mmap(NULL, TRACE_BUFFER_RECORDS * sizeof(trace_record_t), PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffer == MAP_FAILED) return;
+        tcache.trace_buffer = (trace_record_t *)buffer;
+        tcache.trace_thread = __atomic_add_fetch(&trace_threads, 1, __ATOMIC_RELAXED);
+        thread_arena(); // Make sure the buffer is flushed when the thread exits
+    }
+    trace_record_t *record = &tcache.trace_buffer[tcache.trace_count++];
+    record->time_ns = (uint64_t)(now_ns() - trace_start_ns);
+    record->size = size;
+    record->ptr = (uint64_t)(uintptr_t)ptr;
+    record->old_ptr = (uint64_t)(uintptr_t)old_ptr;
+    record->thread = tcache.trace_thread;
+    record->op = op;
+    if (tcache.trace_count == TRACE_BUFFER_RECORDS) trace_flush();
+}
+
+// Natural logarithm of x > 0, accurate enough for drawing sampling intervals (avoids linking libm)
+static double profile_log(double x) {
+    int exponent = 0;
+    while (x >= 2.0) { x /= 2.0; exponent++; }
+    while (x < 1.0) { x *= 2.0; exponent--; }
+    double t = (x - 1.0) / (x + 1.0), t2 = t * t; // ln(x) = 2 atanh(t) for x in [1, 2)
+    return exponent * 0.6931471805599453 + 2.0 * t * (1.0 + t2 * (1.0 / 3 + t2 * (1.0 / 5 + t2 * (1.0 / 7 + t2 / 9))));
+}
+
+// e^-x for x >= 0
+static double profile_neg_exp(double x) {
+    int halvings = 0;
+    while (x > 0.5) { x /= 2.0; halvings++; }
+    double r = 1.0 - x * (1.0 - x / 2 * (1.0 - x / 3 * (1.0 - x / 4 * (1.0 - x / 5 * (1.0 - x / 6)))));
+    while (halvings--) r *= r;
+    return r;
+}
+
+// Draw the number of bytes until the next sample: exponentially distributed with mean profile_rate
+static size_t profile_interval(size_t rate) {
+    if (!tcache.sample_random) tcache.sample_random = (uint64_t)(uintptr_t)&tcache ^ (uint64_t)now_ms() ^ 0x9E3779B97F4A7C15ULL;
+    uint64_t x = tcache.sample_random; // xorshift64
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    tcache.sample_random = x;
+    double u = ((x >> 11) + 1) * (1.0 / 9007199254740993.0); // Uniform in (0, 1]
+    return (size_t)(-profile_log(u) * (double)rate) + 1;
+}
+
+// Slot of ptr in profile_table, or of the empty slot where it would go
+static size_t profile_slot(void *ptr) {
+    size_t i = (size_t)(((uintptr_t)ptr >> 12) * 0x9E3779B97F4A7C15ULL) % PROFILE_MAX_SAMPLES;
+    while (profile_table[i].ptr && profile_table[i].ptr != ptr) i = (i + 1) % PROFILE_MAX_SAMPLES;
+    return i;
+}
+
+// Drop the sample for ptr, if there is one; moves later entries of the probe run back into the hole
+static void profile_remove(void *ptr) {
+    if (!__atomic_load_n(&profile_live, __ATOMIC_RELAXED)) return;
+    pthread_mutex_lock(&profile_lock);
+    if (profile_table) {
+        size_t hole = profile_slot(ptr);
+        if (profile_table[hole].ptr) {
+            profile_table[hole].ptr = NULL;
+            __atomic_store_n(&profile_live, profile_live - 1, __ATOMIC_RELAXED);
+            for (size_t i = (hole + 1) % PROFILE_MAX_SAMPLES; profile_table[i].ptr; i = (i + 1) % PROFILE_MAX_SAMPLES) {
+                size_t home = (size_t)(((uintptr_t)profile_table[i].ptr >> 12) * 0x9E3779B97F4A7C15ULL) % PROFILE_MAX_SAMPLES;
+                // The entry may fill the hole unless its home slot lies cyclically in (hole, i]
+                if ((i > hole && (home <= hole || home > i)) || (i < hole && home <= hole && home > i)) {
+                    profile_table[hole] = profile_table[i];
+                    profile_table[i].ptr = NULL;
+                    hole = i;
+                }
+            }
+        }
+    }
+    pthread_mutex_unlock(&profile_lock);
+}
+
+// A sampled block moved (mremap); keep its sample under the new address
+static void profile_move(void *old_ptr, void *new_ptr, size_t size) {
+    if (!__atomic_load_n(&profile_live, __ATOMIC_RELAXED)) return;
+    pthread_mutex_lock(&profile_lock);
+    profile_sample_t sample;
+    size_t i = profile_table ? profile_slot(old_ptr) : 0;
+    int found = profile_table && profile_table[i].ptr;
+    if (found) sample = profile_table[i];
+    pthread_mutex_unlock(&profile_lock);
+    if (!found) return;
+
+    profile_remove(old_ptr);
+    pthread_mutex_lock(&profile_lock);
+    sample.ptr = new_ptr;
+    sample.size = size;
+    profile_table[profile_slot(new_ptr)] = sample;
+    __atomic_store_n(&profile_live, profile_live + 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&profile_lock);
+}
+
+// Slow path of the sampling countdown: either serve the allocation as a sample or return NULL to let
+// the caller allocate normally
+static void *profile_alloc(size_t aligned_size) {
+    size_t rate = __atomic_load_n(&profile_rate, __ATOMIC_RELAXED);
+    if (!rate || tcache.in_profiler) {
+        tcache.sample_countdown = PROFILE_IDLE_CHECK;
+        return NULL;
+    }
+    tcache.sample_countdown = profile_interval(rate);
+    if (__atomic_load_n(&profile_live, __ATOMIC_RELAXED) >= PROFILE_MAX_SAMPLES / 2) return NULL; // Keep probe runs short
+
+    tcache.in_profiler = 1; // backtrace may allocate
+    profile_sample_t sample;
+    sample.size = aligned_size;
+    sample.depth = backtrace(sample.frames, PROFILE_DEPTH);
+    // Samples get a mapping of their own, at the alignment every my_malloc result has
+    block_t *block = MALLOC_ALIGNMENT > ALIGNMENT ? allocate_aligned_from_system(MALLOC_ALIGNMENT, aligned_size)
+                                                  : allocate_from_system(aligned_size);
+    tcache.in_profiler = 0;
+    if (!block) return NULL;
+
+    sample.ptr = block_to_ptr(block);
+    pthread_mutex_lock(&profile_lock);
+    profile_table[profile_slot(sample.ptr)] = sample;
+    __atomic_store_n(&profile_live, profile_live + 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&profile_lock);
+    return sample.ptr;
+}
+
+// Count an allocation against the sampling interval; returns a sampled allocation when one is due
+static void *profile_check(size_t aligned_size) {
+    if (aligned_size < tcache.sample_countdown) {
+        tcache.sample_countdown -= aligned_size;
+        return NULL;
+    }
+    return profile_alloc(aligned_size);
+}
+
+// Allocate aligned_size bytes (already a multiple of ALIGNMENT) from the caches, arena or system
+static void *malloc_unsampled(size_t aligned_size) {
+    block_t *block;
+    if (aligned_size >= MMAP_THRESHOLD) {
+        // Large requests get their own mapping
+        block = allocate_from_system(aligned_size);
+        if (!block) return NULL; // Return NULL if allocation fails
+        return block_to_ptr(block);
+    }
+
+    arena_t *a = thread_arena();
+    if (aligned_size <= SLAB_MAX_SIZE) {
+        size_t cls = (aligned_size + SLAB_ALIGN - 1) / SLAB_ALIGN - 1;
+        size_t idx = bin_index((cls + 1) * SLAB_ALIGN);
+        // Fast path: pop from this thread's cache without taking any lock
+        if (tcache.entries[idx]) return tcache_pop(idx);
+
+        // Refill: take one lock and pull half a cache's worth of objects of this class
+        arena_lock(a);
+        void *ptr = slab_alloc(a, cls);
+        for (unsigned int i = 1; ptr && i < TCACHE_COUNT / 2; i++) {
+            void *extra = slab_alloc(a, cls);
+            if (!extra) break;
+            tcache_push(idx, extra);
+        }
+        arena_unlock(a);
+        return ptr;
+    } else if (aligned_size <= TCACHE_MAX_SIZE) {
+        size_t idx = bin_index(aligned_size);
+        // Fast path: pop from this thread's cache without taking any lock
+        if (tcache.entries[idx]) return tcache_pop(idx);
+
+        // Refill: take one lock and pull half a cache's worth of blocks of this size
+        arena_lock(a);
+        block = arena_alloc(a, aligned_size, NULL);
+        for (unsigned int i = 1; block && i < TCACHE_COUNT / 2; i++) {
+            block_t *extra = arena_alloc(a, aligned_size, NULL);
+            if (!extra) break;
+            tcache_push(idx, block_to_ptr(extra));
+        }
+        arena_unlock(a);
+    } else {
+        arena_lock(a);
+        block = arena_alloc(a, aligned_size, NULL);
+        arena_unlock(a);
+    }
+    if (!block) return NULL; // Return NULL if allocation fails
+
+    return block_to_ptr(block); // Return a pointer to the memory region after the block metadata
+}
+
+// Allocate memory: the body of my_malloc, which only adds trace recording
+static void *malloc_impl(size_t size) {
     if (size == 0) return NULL; // Return NULL for zero-size allocation
 
     size_t aligned_size = ALIGN(size); // Align the requested size
-    block_t *block, *last = NULL;
+    if (aligned_size < size) return NULL; // Size overflowed
+    tcache.allocations++;
+    void *sampled = profile_check(aligned_size);
+    if (sampled) return sampled;
+    return malloc_unsampled(aligned_size);
+}
+
+// Allocate memory at a multiple of alignment (a power of two): the body of my_memalign.
+// Requests aligned beyond MALLOC_ALIGNMENT are not sampled by the profiler, whose mappings only guarantee that.
+static void *memalign_impl(size_t alignment, size_t size) {
+    if (alignment <= ALIGNMENT) return malloc_impl(size);
+    if (size == 0) return NULL; // Return NULL for zero-size allocation
+
+    size_t aligned_size = ALIGN(size);
+    size_t padded = aligned_size + alignment + BLOCK_SIZE + MIN_PAYLOAD; // Worst case with leading padding
+    if (aligned_size < size || padded < aligned_size) return NULL; // Size overflowed
+    tcache.allocations++;
+    if (alignment <= MALLOC_ALIGNMENT) {
+        void *sampled = profile_check(aligned_size);
+        if (sampled) return sampled;
+    }
 
-    // Try to find a free block in the free list
-    if ((block = find_free_block(&last, aligned_size))) {
-        block->free = 0; // Mark the block as in use
-        split_block(block, aligned_size); // Split the block if necessary
+    // Slab objects already sit at multiples of SLAB_ALIGN
+    if (alignment <= SLAB_ALIGN && aligned_size <= SLAB_MAX_SIZE) return malloc_unsampled(aligned_size);
+    if (aligned_size <= TCACHE_MAX_SIZE) {
+        // A cached block of the size will do if it happens to sit at the alignment
+        size_t idx = bin_index(aligned_size);
+        if (tcache.entries[idx] && !((uintptr_t)tcache.entries[idx] & (alignment - 1))) return tcache_pop(idx);
+    }
+
+    block_t *block;
+    if (padded >= MMAP_THRESHOLD) {
+        block = allocate_aligned_from_system(alignment, aligned_size);
     } else {
-        size_t alloc_size = aligned_size + BLOCK_SIZE;
+        arena_t *a = thread_arena();
+        arena_lock(a);
+        block = arena_alloc_aligned(a, alignment, aligned_size);
+        arena_unlock(a);
+    }
+    return block ? block_to_ptr(block) : NULL;
+}
 
-        // Allocate a new block from the system
-        block = allocate_from_system(alloc_size);
-        if (!block) return NULL; // Return NULL if allocation fails
+// Allocate and zero-initialize memory: the body of my_calloc
+static void *calloc_impl(size_t nmemb, size_t size) {
+    size_t total_size;
+    if (__builtin_mul_overflow(nmemb, size, &total_size)) return NULL; // nmemb * size does not fit in a size_t
 
-        block->size = alloc_size - BLOCK_SIZE; // Set the size of the allocated block
-        block->free = 0; // Mark the block as in use
-        block->next = NULL;
-        block->prev = last;
+    size_t aligned_size = ALIGN(total_size);
+    if (total_size == 0 || aligned_size < total_size || aligned_size <= TCACHE_MAX_SIZE) {
+        // Small objects come from caches and slabs of recycled memory; clearing them is cheap
+        void *ptr = memalign_impl(MALLOC_ALIGNMENT, total_size);
+        if (ptr) {
+            memset(ptr, 0, total_size); // Zero-initialize the memory
+        }
+        return ptr;
+    }
 
-        // Add the new block to the free list
-        if (!free_list) {
-            free_list = block;
+    // Memory fresh from the kernel is already zero: clearing it would only fault every page in
+    block_t *block;
+    size_t dirty = 0;
+    tcache.allocations++;
+    void *sampled = profile_check(aligned_size);
+    if (sampled) return sampled; // A fresh mapping, so already zero
+    if (aligned_size >= MMAP_THRESHOLD) {
+        block = MALLOC_ALIGNMENT > ALIGNMENT ? allocate_aligned_from_system(MALLOC_ALIGNMENT, aligned_size)
+                                             : allocate_from_system(aligned_size);
+    } else {
+        arena_t *a = thread_arena();
+        arena_lock(a);
+        if (MALLOC_ALIGNMENT > ALIGNMENT) {
+            block = arena_alloc_aligned(a, MALLOC_ALIGNMENT, aligned_size);
+            dirty = aligned_size; // An aligned block may hold old data anywhere
         } else {
-            last->next = block;
+            block = arena_alloc(a, aligned_size, &dirty);
         }
-
-        split_block(block, aligned_size); // Split the block if necessary
+        arena_unlock(a);
     }
+    if (!block) return NULL; // Return NULL if allocation fails
 
-    return (void *)(block + 1); // Return a pointer to the memory region after the block metadata
+    memset(block_to_ptr(block), 0, dirty < total_size ? dirty : total_size); // Clear only what may hold old data
+    return block_to_ptr(block);
 }
 
-// Custom calloc function to allocate and zero-initialize memory
-void *my_calloc(size_t nmemb, size_t size) {
-    size_t total_size = nmemb * size; // Calculate total memory size
-    void *ptr = my_malloc(total_size); // Allocate the memory
-    if (ptr) {
-        memset(ptr, 0, total_size); // Zero-initialize the memory
+// Allocate count objects of size bytes into out: the body of my_malloc_batch. Returns how many were
+// allocated; the cache is emptied first and the rest comes from the arena under a single lock.
+static size_t malloc_batch_impl(size_t size, size_t count, void **out) {
+    size_t aligned_size = ALIGN(size);
+    if (size == 0 || aligned_size < size) return 0;
+    int slab = aligned_size <= SLAB_MAX_SIZE;
+    if (aligned_size >= MMAP_THRESHOLD || (MALLOC_ALIGNMENT > ALIGNMENT && (!slab || MALLOC_ALIGNMENT > SLAB_ALIGN))) {
+        // One mapping each, or blocks that must be aligned beyond ALIGNMENT: one at a time, as my_malloc does
+        size_t n = 0;
+        while (n < count && (out[n] = memalign_impl(MALLOC_ALIGNMENT, size))) n++;
+        return n;
+    }
+    tcache.allocations += count;
+
+    // Take the profiler's samples first: profile_alloc may allocate, so it must not run under the lock
+    size_t n = 0, total;
+    if (!__builtin_mul_overflow(aligned_size, count, &total) && total < tcache.sample_countdown) {
+        tcache.sample_countdown -= total;
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            void *sampled = profile_check(aligned_size);
+            if (sampled) out[n++] = sampled;
+        }
+    }
+
+    arena_t *a = thread_arena();
+    size_t cls = (aligned_size + SLAB_ALIGN - 1) / SLAB_ALIGN - 1;
+    if (aligned_size <= TCACHE_MAX_SIZE) {
+        size_t idx = bin_index(slab ? (cls + 1) * SLAB_ALIGN : aligned_size);
+        while (n < count && tcache.entries[idx]) out[n++] = tcache_pop(idx);
+    }
+    if (n < count) {
+        arena_lock(a);
+        while (n < count) {
+            block_t *block = slab ? NULL : arena_alloc(a, aligned_size, NULL);
+            void *ptr = slab ? slab_alloc(a, cls) : block ? block_to_ptr(block) : NULL;
+            if (!ptr) break;
+            out[n++] = ptr;
+        }
+        arena_unlock(a);
     }
-    return ptr; // Return the allocated and initialized memory
+    return n;
 }
 
-// Custom free function to free allocated memory
-void my_free(void *ptr) {
+// Free allocated memory: the body of my_free
+static void free_impl(void *ptr) {
     if (!ptr) return; // Do nothing if the pointer is NULL
+    tcache.frees++;
 
-    block_t *block = (block_t *)ptr - 1; // Get the block metadata
-    block->free = 1; // Mark the block as free
+    unsigned char owner = region_owner(ptr);
+    if (owner & REGION_SLAB) {
+        // Header-less slab object: keep it in this thread's cache, draining half of the bin when full
+        size_t idx = bin_index(slab_of(ptr)->obj_size);
+        if (already_cached(idx, ptr)) return; // Ignore double frees instead of caching the object twice
+        thread_arena(); // Make sure this thread's cache is flushed when it exits
+        if (tcache.counts[idx] >= TCACHE_COUNT) {
+            tcache_flush(idx, TCACHE_COUNT / 2);
+        }
+        tcache_push(idx, ptr);
+        return;
+    }
 
-    coalesce(); // Coalesce adjacent free blocks
+    block_t *block = ptr_to_block(ptr); // Get the block metadata
+    size_t word = load_word(block);
+    if (word & BLOCK_FREE) return; // Ignore double frees instead of linking the block into a bin twice
 
-    // If the block is the only one in the free list and it's free, unmap it
-    if (block->prev == NULL && block->next == NULL) {
-        munmap(block, block->size + BLOCK_SIZE); // Unmap the memory
-        free_list = NULL; // Reset the free list
+    if (word & BLOCK_MMAPPED) {
+        size_t size = word & ~(size_t)BLOCK_FLAGS;
+        char *start = mapping_start(block);
+        size_t length = (size_t)((char *)ptr + size - start);
+        __atomic_fetch_sub(&stats.direct, size, __ATOMIC_RELAXED);
+        count_in_use(0, size);
+        count_mapped(0, length);
+        count_call(&stats.munmap_calls);
+        munmap(start, length); // Dedicated mappings go straight back to the OS
+        profile_remove(ptr); // Sampled allocations all have their own mapping
+        return;
     }
+
+    size_t size = word & ~(size_t)BLOCK_FLAGS;
+    if (size <= TCACHE_MAX_SIZE) {
+        size_t idx = bin_index(size);
+        if (already_cached(idx, ptr)) return;
+        if (size > SLAB_MAX_SIZE) {
+            // Fast path: keep the block in this thread's cache; drain half of the bin when it is full
+            thread_arena();
+            if (tcache.counts[idx] >= TCACHE_COUNT) {
+                tcache_flush(idx, TCACHE_COUNT / 2);
+            }
+            tcache_push(idx, ptr);
+            return;
+        }
+    }
+
+    arena_t *a = &arenas[owner - 1];
+    if (a != thread_arena()) {
+        if (remote_queued(ptr)) return; // Ignore double frees instead of queueing the block twice
+        remote_push(&a->remote_free, ptr); // Leave it to the owning arena instead of contending for its lock
+        return;
+    }
+    arena_lock(a);
+    release_block(a, block); // Coalesce with free neighbours and return the result to its bin
+    arena_unlock(a);
 }
 
-// Custom realloc function to resize allocated memory
-void *my_realloc(void *ptr, size_t size) {
-    if (!ptr) return my_malloc(size); // Allocate new memory if the pointer is NULL
+// Free count pointers: the body of my_free_batch. Objects the cache has room for go there; the rest
+// of this arena's objects are released under a single lock and other arenas' are queued for them.
+static void free_batch_impl(void **ptrs, size_t count) {
+    arena_t *own = thread_arena();
+    int locked = 0;
+    for (size_t i = 0; i < count; i++) {
+        void *ptr = ptrs[i];
+        if (!ptr) continue;
+        unsigned char owner = region_owner(ptr);
+        int slab = owner & REGION_SLAB;
+        size_t size;
+        if (slab) {
+            size = slab_of(ptr)->obj_size;
+        } else {
+            size_t word = load_word(ptr_to_block(ptr));
+            if (word & BLOCK_FREE) continue; // Ignore double frees
+            if (word & BLOCK_MMAPPED) {
+                if (locked) {
+                    arena_unlock(own); // Unmapping may take the profiler's lock, which is never taken inside an arena's
+                    locked = 0;
+                }
+                free_impl(ptr);
+                continue;
+            }
+            size = word & ~(size_t)BLOCK_FLAGS;
+        }
+        tcache.frees++;
+
+        if (size <= TCACHE_MAX_SIZE) {
+            size_t idx = bin_index(size);
+            if (already_cached(idx, ptr)) continue;
+            if (tcache.counts[idx] < TCACHE_COUNT && (slab || size > SLAB_MAX_SIZE)) {
+                tcache_push(idx, ptr);
+                continue;
+            }
+        }
+
+        arena_t *a = &arenas[(owner & ~REGION_SLAB) - 1];
+        if (a != own) {
+            if (remote_queued(ptr)) continue;
+            remote_push(slab ? &a->remote_slab_free : &a->remote_free, ptr);
+            continue;
+        }
+        if (!locked) {
+            arena_lock(own);
+            locked = 1;
+        }
+        if (slab) slab_free(own, ptr);
+        else release_block(own, ptr_to_block(ptr));
+    }
+    if (locked) arena_unlock(own);
+}
+
+// Free memory whose requested size the caller knows: the body of my_free_sized. A slab object's class
+// follows from the size, so it goes to the cache without reading its slab header; blocks with a header
+// need it for coalescing anyway and take the my_free path.
+static void free_sized_impl(void *ptr, size_t size) {
+    size_t aligned_size = ALIGN(size);
+    if (!ptr || aligned_size > SLAB_MAX_SIZE || aligned_size < size || !(region_owner(ptr) & REGION_SLAB)) {
+        free_impl(ptr);
+        return;
+    }
+    tcache.frees++;
+
+    // A slab object realloc'd to a smaller size still sits in its larger slot; caching it under the
+    // smaller class is safe, as slots of any class are large enough and are returned via their slab
+    size_t idx = bin_index((aligned_size + SLAB_ALIGN - 1) / SLAB_ALIGN * SLAB_ALIGN);
+    if (already_cached(idx, ptr)) return; // Ignore double frees instead of caching the object twice
+    thread_arena();
+    if (tcache.counts[idx] >= TCACHE_COUNT) {
+        tcache_flush(idx, TCACHE_COUNT / 2);
+    }
+    tcache_push(idx, ptr);
+}
+
+// Resize allocated memory: the body of my_realloc
+static void *realloc_impl(void *ptr, size_t size) {
+    if (!ptr) return malloc_impl(size); // Allocate new memory if the pointer is NULL
     if (size == 0) {
-        my_free(ptr); // Free the memory if size is 0
+        free_impl(ptr); // Free the memory if size is 0
         return NULL;
     }
 
-    block_t *block = (block_t *)ptr - 1; // Get the block metadata
-    if (block->size >= size) {
-        split_block(block, size); // Split the block if the new size is smaller
+    unsigned char owner = region_owner(ptr);
+    if (owner & REGION_SLAB) {
+        size_t obj_size = slab_of(ptr)->obj_size;
+        if (obj_size >= size) return ptr; // Still fits in its slab slot
+
+        void *new_ptr = memalign_impl(MALLOC_ALIGNMENT, size);
+        if (!new_ptr) return NULL; // Return NULL if allocation fails
+        memcpy(new_ptr, ptr, obj_size); // Copy data to the new memory
+        free_impl(ptr);
+        return new_ptr;
+    }
+
+    block_t *block = ptr_to_block(ptr); // Get the block metadata
+    size_t old_size = block_size(block);
+    size_t aligned_size = ALIGN(size);
+    if (aligned_size < size) return NULL; // Size overflowed
+
+    if (has_flag(block, BLOCK_MMAPPED) && aligned_size >= MMAP_THRESHOLD) {
+        // Let the kernel grow or shrink the mapping; the pages move without being copied
+        block = remap_from_system(block, aligned_size);
+        if (!block) return NULL;
+        profile_move(ptr, block_to_ptr(block), block_size(block));
+        return block_to_ptr(block);
+    }
+
+    if (old_size >= size) {
+        if (owner) {
+            arena_t *a = &arenas[owner - 1];
+            arena_lock(a);
+            split_block(a, block, aligned_size); // Split the block if the new size is smaller
+            arena_unlock(a);
+        }
         return ptr; // Return the original pointer
     }
 
+    if (owner) {
+        // Try to grow into the free block that follows before moving the data
+        arena_t *a = &arenas[owner - 1];
+        arena_lock(a);
+        int grown = grow_in_place(a, block, aligned_size);
+        arena_unlock(a);
+        if (grown) return ptr;
+    }
+
     // Allocate new memory if the block is too small
-    void *new_ptr = my_malloc(size);
+    void *new_ptr = memalign_impl(MALLOC_ALIGNMENT, size);
     if (!new_ptr) return NULL; // Return NULL if allocation fails
 
-    memcpy(new_ptr, ptr, block->size); // Copy data to the new memory
-    my_free(ptr); // Free the old block
+    memcpy(new_ptr, ptr, old_size); // Copy data to the new memory
+    free_impl(ptr); // Free the old block
 
     return new_ptr; // Return the new pointer
 }
+
+// Custom malloc function to allocate memory
+void *my_malloc(size_t size) {
+    void *ptr = memalign_impl(MALLOC_ALIGNMENT, size);
+    if (__atomic_load_n(&trace_fd, __ATOMIC_RELAXED) >= 0) trace_record(TRACE_MALLOC, size, ptr, NULL);
+    return ptr;
+}
+
+// Custom calloc function to allocate and zero-initialize memory
+void *my_calloc(size_t nmemb, size_t size) {
+    void *ptr = calloc_impl(nmemb, size);
+    if (__atomic_load_n(&trace_fd, __ATOMIC_RELAXED) >= 0) trace_record(TRACE_CALLOC, nmemb * size, ptr, NULL);
+    return ptr;
+}
+
+// Custom free function to free allocated memory
+void my_free(void *ptr) {
+    if (ptr && __atomic_load_n(&trace_fd, __ATOMIC_RELAXED) >= 0) trace_record(TRACE_FREE, 0, ptr, NULL);
+    free_impl(ptr);
+}
+
+// Custom realloc function to resize allocated memory
+void *my_realloc(void *ptr, size_t size) {
+    void *new_ptr = realloc_impl(ptr, size);
+    if (__atomic_load_n(&trace_fd, __ATOMIC_RELAXED) >= 0) trace_record(TRACE_REALLOC, size, new_ptr, ptr);
+    return new_ptr;
+}
+
+// Allocate size bytes at a multiple of alignment, which must be a power of two; freed with my_free
+void *my_memalign(size_t alignment, size_t size) {
+    if (!alignment || (alignment & (alignment - 1))) return NULL;
+    void *ptr = memalign_impl(alignment, size);
+    if (__atomic_load_n(&trace_fd, __ATOMIC_RELAXED) >= 0) trace_record(TRACE_MEMALIGN, size, ptr, (void *)alignment);
+    return ptr;
+}
+
+// POSIX interface: the alignment must also be a multiple of sizeof(void *). Returns 0, EINVAL or ENOMEM.
+int my_posix_memalign(void **memptr, size_t alignment, size_t size) {
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1))) return EINVAL;
+    void *ptr = my_memalign(alignment, size);
+    if (!ptr && size) return ENOMEM;
+    *memptr = ptr;
+    return 0;
+}
+
+// C11 interface: the same as my_memalign
+void *my_aligned_alloc(size_t alignment, size_t size) {
+    return my_memalign(alignment, size);
+}
+
+// Allocate count objects of size bytes, storing them in out[0..count). Returns how many were
+// allocated, which is less than count only if memory ran out; the objects are freed individually or
+// with my_free_batch.
+size_t my_malloc_batch(size_t size, size_t count, void **out) {
+    size_t n = malloc_batch_impl(size, count, out);
+    if (__atomic_load_n(&trace_fd, __ATOMIC_RELAXED) >= 0) {
+        for (size_t i = 0; i < n; i++) trace_record(TRACE_MALLOC, size, out[i], NULL);
+    }
+    return n;
+}
+
+// Free count pointers at once; NULL entries are skipped
+void my_free_batch(void **ptrs, size_t count) {
+    if (__atomic_load_n(&trace_fd, __ATOMIC_RELAXED) >= 0) {
+        for (size_t i = 0; i < count; i++) {
+            if (ptrs[i]) trace_record(TRACE_FREE, 0, ptrs[i], NULL);
+        }
+    }
+    free_batch_impl(ptrs, count);
+}
+
+// Free ptr, which was allocated (or last realloc'd) with the given size; cheaper than my_free for
+// small objects. The size must not exceed the one requested, or the slot is reused for larger objects.
+void my_free_sized(void *ptr, size_t size) {
+    if (ptr && __atomic_load_n(&trace_fd, __ATOMIC_RELAXED) >= 0) trace_record(TRACE_FREE, 0, ptr, NULL);
+    free_sized_impl(ptr, size);
+}
+
+// Bytes that can be used at ptr, at least the size requested; 0 for NULL. Writing up to this size is
+// allowed without a my_realloc call.
+size_t my_malloc_usable_size(void *ptr) {
+    if (!ptr) return 0;
+    if (region_owner(ptr) & REGION_SLAB) return slab_of(ptr)->obj_size;
+    return block_size(ptr_to_block(ptr));
+}
+
+// Purge every arena now instead of waiting for the decay delay, e.g. after a phase that freed a lot
+void my_malloc_trim(void) {
+    pthread_once(&arenas_once, init_arenas);
+    for (size_t idx = 0; idx < NUM_SMALL_BINS; idx++) {
+        tcache_flush(idx, TCACHE_COUNT); // The caller's cached objects can go too
+    }
+    for (unsigned int i = 0; i < MAX_ARENAS; i++) {
+        arena_lock(&arenas[i]);
+        purge_arena(&arenas[i]);
+        arena_unlock(&arenas[i]);
+    }
+}
+
+// Snapshot of the allocator's state, as returned by my_mallinfo. Memory only ever comes from mmap, so
+// there is no sbrk count to report.
+typedef struct my_mallinfo_t {
+    size_t mapped;                           // Bytes currently mapped from the OS
+    size_t peak_mapped;                      // Most bytes ever mapped at once
+    size_t in_use;                           // Bytes handed out to the program; objects in thread caches count as in use
+    size_t peak_in_use;                      // Most bytes ever in use at once, as of arena unlocks
+    size_t free;                             // Bytes free inside arenas: binned blocks, top blocks and slab space
+    size_t largest_free;                     // Largest free block
+    double fragmentation;                    // External fragmentation: 1 - largest_free / free_blocks
+    size_t free_by_bin[NUM_BINS];            // Free block bytes per size-class bin
+    size_t free_by_slab_class[SLAB_CLASSES]; // Free object bytes in partly used slabs per class
+    size_t mmap_calls;
+    size_t munmap_calls;
+    size_t mremap_calls;
+    size_t madvise_calls;
+} my_mallinfo_t;
+
+// Collect allocator statistics. Every arena is locked in turn while its free lists are walked,
+// so this is meant for periodic monitoring rather than hot paths.
+my_mallinfo_t my_mallinfo(void) {
+    my_mallinfo_t info;
+    memset(&info, 0, sizeof(info));
+    pthread_once(&arenas_once, init_arenas);
+
+    size_t free_blocks = 0; // Free bytes in blocks, which fragmentation is measured over
+    for (unsigned int i = 0; i < MAX_ARENAS; i++) {
+        arena_t *a = &arenas[i];
+        arena_lock(a);
+        info.in_use += a->allocated;
+        for (size_t idx = 0; idx < NUM_BINS; idx++) {
+            for (block_t *block = a->bins[idx]; block; block = block->next_free) {
+                info.free_by_bin[idx] += block_size(block);
+                if (block_size(block) > info.largest_free) info.largest_free = block_size(block);
+            }
+        }
+        if (a->top) {
+            free_blocks += block_size(a->top);
+            if (block_size(a->top) > info.largest_free) info.largest_free = block_size(a->top);
+        }
+        for (size_t cls = 0; cls < SLAB_CLASSES; cls++) {
+            for (slab_t *slab = a->slabs[cls]; slab; slab = slab->next) {
+                info.free_by_slab_class[cls] += (size_t)(slab->capacity - slab->used) * slab->obj_size;
+            }
+        }
+        for (slab_t *slab = a->empty_slabs; slab; slab = slab->next) {
+            info.free += SLAB_PAGE_SIZE - SLAB_HEADER_SIZE;
+        }
+        info.free += a->purged_slabs * (SLAB_PAGE_SIZE - SLAB_HEADER_SIZE);
+        info.free += (size_t)(a->slab_end - a->slab_cursor);
+        arena_unlock(a);
+    }
+    for (size_t idx = 0; idx < NUM_BINS; idx++) free_blocks += info.free_by_bin[idx];
+    for (size_t cls = 0; cls < SLAB_CLASSES; cls++) info.free += info.free_by_slab_class[cls];
+    info.free += free_blocks;
+    info.in_use += __atomic_load_n(&stats.direct, __ATOMIC_RELAXED);
+    info.fragmentation = free_blocks ? 1.0 - (double)info.largest_free / (double)free_blocks : 0.0;
+
+    info.mapped = __atomic_load_n(&stats.mapped, __ATOMIC_RELAXED);
+    info.peak_mapped = __atomic_load_n(&stats.peak_mapped, __ATOMIC_RELAXED);
+    info.peak_in_use = __atomic_load_n(&stats.peak_in_use, __ATOMIC_RELAXED);
+    info.mmap_calls = __atomic_load_n(&stats.mmap_calls, __ATOMIC_RELAXED);
+    info.munmap_calls = __atomic_load_n(&stats.munmap_calls, __ATOMIC_RELAXED);
+    info.mremap_calls = __atomic_load_n(&stats.mremap_calls, __ATOMIC_RELAXED);
+    info.madvise_calls = __atomic_load_n(&stats.madvise_calls, __ATOMIC_RELAXED);
+    return info;
+}
+
+// Write the statistics as a single JSON object; only non-empty size classes are listed
+void my_malloc_stats_json(FILE *out) {
+    my_mallinfo_t info = my_mallinfo();
+    fprintf(out, "{\"mapped\":%zu,\"peak_mapped\":%zu,\"in_use\":%zu,\"peak_in_use\":%zu,\"free\":%zu,"
+                 "\"largest_free\":%zu,\"fragmentation\":%.4f,", info.mapped, info.peak_mapped, info.in_use,
+            info.peak_in_use, info.free, info.largest_free, info.fragmentation);
+    fprintf(out, "\"syscalls\":{\"mmap\":%zu,\"munmap\":%zu,\"mremap\":%zu,\"madvise\":%zu},",
+            info.mmap_calls, info.munmap_calls, info.mremap_calls, info.madvise_calls);
+
+    // Bins are named by the smallest block size they hold
+    fprintf(out, "\"free_by_size\":{");
+    const char *sep = "";
+    for (size_t idx = 0; idx < NUM_BINS; idx++) {
+        if (!info.free_by_bin[idx]) continue;
+        size_t min = idx < NUM_SMALL_BINS ? (idx + 1) * ALIGNMENT
+                   : idx == NUM_SMALL_BINS ? SMALL_BIN_MAX + ALIGNMENT : (size_t)1 << (idx - NUM_SMALL_BINS + 9);
+        fprintf(out, "%s\"%zu\":%zu", sep, min, info.free_by_bin[idx]);
+        sep = ",";
+    }
+    fprintf(out, "},\"slab_free_by_size\":{");
+    sep = "";
+    for (size_t cls = 0; cls < SLAB_CLASSES; cls++) {
+        if (!info.free_by_slab_class[cls]) continue;
+        fprintf(out, "%s\"%zu\":%zu", sep, (cls + 1) * SLAB_ALIGN, info.free_by_slab_class[cls]);
+        sep = ",";
+    }
+    fprintf(out, "}}\n");
+}
+
+// Start publishing live counters to a stats page (a file under /dev/shm, or an absolute path) that
+// heapmon.c can read from another process; returns 0 on success and -1 if the page could not be set up
+int my_malloc_stats_shm(const char *name) {
+    pthread_once(&arenas_once, init_arenas);
+    if (shm_stats) return 0;
+    return open_stats_shm(name);
+}
+
+// Start the sampling heap profiler with a sample taken about once per sample_bytes allocated;
+// returns 0 on success and -1 if the sample table could not be set up
+int my_malloc_profile_start(size_t sample_bytes) {
+    pthread_once(&arenas_once, init_arenas);
+    if (!sample_bytes) return -1;
+    return start_profile(sample_bytes);
+}
+
+// Stop taking new samples; samples of allocations that are still live stay in the profile
+void my_malloc_profile_stop(void) {
+    __atomic_store_n(&profile_rate, 0, __ATOMIC_RELAXED);
+}
+
+// Order samples by stack so equal stacks end up next to each other
+static int profile_compare(const void *a, const void *b) {
+    const profile_sample_t *x = *(const profile_sample_t *const *)a, *y = *(const profile_sample_t *const *)b;
+    if (x->depth != y->depth) return x->depth < y->depth ? -1 : 1;
+    return memcmp(x->frames, y->frames, (size_t)x->depth * sizeof(void *));
+}
+
+// Write the live sampled allocations as a heap profile, one line per distinct stack. Each sample of size
+// s stands for 1 / (1 - e^(-s/rate)) allocations like it, which is what the counts and bytes estimate.
+void my_malloc_profile_dump(FILE *out) {
+    thread_arena();
+    tcache.in_profiler = 1; // stdio and qsort may allocate
+    pthread_mutex_lock(&profile_lock);
+    size_t rate = profile_rate ? profile_rate : 1;
+    size_t count = 0;
+    profile_sample_t **sorted = NULL;
+    if (profile_table && profile_live) {
+        sorted = (profile_sample_t **)mmap(NULL, profile_live * sizeof(*sorted), PROT_READ | PROT_WRITE,
+                                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (sorted == MAP_FAILED) sorted = NULL;
+    }
+    if (sorted) {
+        for (size_t i = 0; i < PROFILE_MAX_SAMPLES; i++) {
+            if (profile_table[i].ptr) sorted[count++] = &profile_table[i];
+        }
+        qsort(sorted, count, sizeof(*sorted), profile_compare);
+    }
+
+    double total_objects = 0, total_bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        double scale = 1.0 / (1.0 - profile_neg_exp((double)sorted[i]->size / (double)rate));
+        total_objects += scale;
+        total_bytes += scale * (double)sorted[i]->size;
+    }
+    fprintf(out, "heap profile: %6.0f: %8.0f [%6.0f: %8.0f] @ heap_v2/%zu\n",
+            total_objects, total_bytes, total_objects, total_bytes, rate);
+    for (size_t i = 0; i < count; ) {
+        double objects = 0, bytes = 0;
+        size_t j = i;
+        for (; j < count && profile_compare(&sorted[i], &sorted[j]) == 0; j++) {
+            double scale = 1.0 / (1.0 - profile_neg_exp((double)sorted[j]->size / (double)rate));
+            objects += scale;
+            bytes += scale * (double)sorted[j]->size;
+        }
+        fprintf(out, "%6.0f: %8.0f [%6.0f: %8.0f] @", objects, bytes, objects, bytes);
+        for (int f = 0; f < sorted[i]->depth; f++) fprintf(out, " %p", sorted[i]->frames[f]);
+        fprintf(out, "\n");
+        i = j;
+    }
+    if (sorted) munmap(sorted, profile_live * sizeof(*sorted));
+    pthread_mutex_unlock(&profile_lock);
+
+    // pprof needs the mappings to symbolize the addresses
+    fprintf(out, "\nMAPPED_LIBRARIES:\n");
+    int fd = open("/proc/self/maps", O_RDONLY);
+    if (fd >= 0) {
+        char buf[4096];
+        ssize_t n;
+        while ((n = read(fd, buf, sizeof(buf))) > 0) fwrite(buf, 1, (size_t)n, out);
+        close(fd);
+    }
+    fflush(out);
+    tcache.in_profiler = 0;
+}
+
+// Start recording every allocator call to a trace file for trace_replay.c; returns 0 on success and -1
+// if the file could not be created or a trace is already being recorded
+int my_malloc_trace_start(const char *path) {
+    pthread_once(&arenas_once, init_arenas);
+    if (__atomic_load_n(&trace_fd, __ATOMIC_RELAXED) >= 0) return -1;
+    return start_trace(path);
+}
+
+// Stop recording and close the trace file. Records other threads still buffer are dropped, so stop
+// once the threads being traced are done.
+void my_malloc_trace_stop(void) {
+    trace_flush();
+    pthread_mutex_lock(&trace_lock);
+    int fd = __atomic_exchange_n(&trace_fd, -1, __ATOMIC_RELAXED);
+    if (fd >= 0) close(fd);
+    pthread_mutex_unlock(&trace_lock);
+}
+
+
+// Header at the start of every bump arena chunk. Chunks form a list in the order the arena moves
+// through them; the ones after the current chunk are empty and reused before new ones are mapped.
+typedef struct bump_chunk {
+    struct bump_chunk *next;
+    char *end; // End of the chunk's mapping
+} bump_chunk_t;
+
+// A bump arena. It lives at the start of its first chunk, so creating one takes a single mmap.
+// Not thread-safe: each arena is meant to be used by one thread at a time, e.g. one per request.
+typedef struct my_arena {
+    bump_chunk_t *first;
+    bump_chunk_t *current;  // Chunk being allocated from
+    char *cursor;           // Next free byte of the current chunk
+    char *end;              // End of the current chunk
+    char *base;             // First usable byte of the first chunk, after this header
+    size_t next_chunk_size; // Size of the next chunk to map
+} my_arena_t;
+
+// Position in a bump arena, to rewind to later
+typedef struct my_arena_mark {
+    bump_chunk_t *chunk;
+    char *cursor;
+} my_arena_mark_t;
+
+// First usable byte of a chunk, aligned for any object
+static char *bump_chunk_start(bump_chunk_t *chunk) {
+    return (char *)(((uintptr_t)(chunk + 1) + BUMP_ALIGN - 1) & ~(uintptr_t)(BUMP_ALIGN - 1));
+}
+
+// Map a chunk that holds at least size bytes at the given alignment
+static bump_chunk_t *bump_map_chunk(size_t chunk_size, size_t alignment, size_t size) {
+    size_t need = page_align(sizeof(bump_chunk_t) + BUMP_ALIGN + alignment + size);
+    if (need < size) return NULL; // Size overflowed
+    if (chunk_size < need) chunk_size = need;
+
+    void *mem = mmap(NULL, chunk_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    count_call(&stats.mmap_calls);
+    if (mem == MAP_FAILED) {
+        return NULL;
+    }
+    count_mapped(chunk_size, 0);
+    advise_huge(mem, chunk_size);
+    bump_chunk_t *chunk = (bump_chunk_t *)mem;
+    chunk->next = NULL;
+    chunk->end = (char *)mem + chunk_size;
+    return chunk;
+}
+
+// Aligned position of size bytes at cursor, or NULL if they do not fit before end
+static char *bump_fit(char *cursor, char *end, size_t alignment, size_t size) {
+    uintptr_t ptr = ((uintptr_t)cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (ptr > (uintptr_t)end || size > (uintptr_t)end - ptr) return NULL;
+    return (char *)ptr;
+}
+
+// Slow path of my_arena_alloc_aligned: move on to the next empty chunk, or map a new one after the
+// current chunk when the next one is missing or too small for the request
+static void *bump_refill(my_arena_t *arena, size_t alignment, size_t size) {
+    bump_chunk_t *chunk = arena->current->next;
+    char *ptr = chunk ? bump_fit(bump_chunk_start(chunk), chunk->end, alignment, size) : NULL;
+    if (!ptr) {
+        chunk = bump_map_chunk(arena->next_chunk_size, alignment, size);
+        if (!chunk) return NULL;
+        if (arena->next_chunk_size < BUMP_CHUNK_MAX) arena->next_chunk_size *= 2;
+        chunk->next = arena->current->next;
+        arena->current->next = chunk;
+        ptr = bump_fit(bump_chunk_start(chunk), chunk->end, alignment, size);
+    }
+    arena->current = chunk;
+    arena->cursor = ptr + size;
+    arena->end = chunk->end;
+    return ptr;
+}
+
+// Create an empty bump arena; NULL if memory ran out
+my_arena_t *my_arena_create(void) {
+    bump_chunk_t *chunk = bump_map_chunk(BUMP_CHUNK_SIZE, BUMP_ALIGN, sizeof(my_arena_t));
+    if (!chunk) return NULL;
+    my_arena_t *arena = (my_arena_t *)bump_chunk_start(chunk);
+    arena->first = chunk;
+    arena->current = chunk;
+    arena->base = (char *)arena + ((sizeof(my_arena_t) + BUMP_ALIGN - 1) & ~(size_t)(BUMP_ALIGN - 1));
+    arena->cursor = arena->base;
+    arena->end = chunk->end;
+    arena->next_chunk_size = BUMP_CHUNK_SIZE * 2;
+    return arena;
+}
+
+// Allocate size bytes at a multiple of alignment (a power of two) from the arena. The memory is not
+// zeroed, and is only released by my_arena_rewind, my_arena_reset or my_arena_destroy, never my_free.
+void *my_arena_alloc_aligned(my_arena_t *arena, size_t alignment, size_t size) {
+    if (!alignment || (alignment & (alignment - 1))) return NULL;
+    char *ptr = bump_fit(arena->cursor, arena->end, alignment, size);
+    if (!ptr) return bump_refill(arena, alignment, size);
+    arena->cursor = ptr + size;
+    return ptr;
+}
+
+// Allocate size bytes from the arena, aligned to BUMP_ALIGN
+void *my_arena_alloc(my_arena_t *arena, size_t size) {
+    return my_arena_alloc_aligned(arena, BUMP_ALIGN, size);
+}
+
+// Current position of the arena
+my_arena_mark_t my_arena_mark(my_arena_t *arena) {
+    my_arena_mark_t mark = { arena->current, arena->cursor };
+    return mark;
+}
+
+// Release everything allocated since the mark was taken; marks taken after it become invalid
+void my_arena_rewind(my_arena_t *arena, my_arena_mark_t mark) {
+    arena->current = mark.chunk;
+    arena->cursor = mark.cursor;
+    arena->end = mark.chunk->end;
+}
+
+// Release everything allocated from the arena in constant time. Its chunks stay mapped and are
+// reused by later allocations.
+void my_arena_reset(my_arena_t *arena) {
+    arena->current = arena->first;
+    arena->cursor = arena->base;
+    arena->end = arena->first->end;
+}
+
+// Release the arena and unmap all of its chunks
+void my_arena_destroy(my_arena_t *arena) {
+    if (!arena) return;
+    bump_chunk_t *chunk = arena->first; // The arena itself goes with the first chunk
+    while (chunk) {
+        bump_chunk_t *next = chunk->next;
+        size_t size = (size_t)(chunk->end - (char *)chunk);
+        munmap(chunk, size);
+        count_call(&stats.munmap_calls);
+        count_mapped(0, size);
+        chunk = next;
+    }
+}
@@ -0,0 +1,67 @@
+// Per-object cost of my_malloc_batch / my_free_batch against the same objects allocated and freed one
+// call at a time, with the system malloc for reference. Each round allocates a batch of nodes, touches
+// them as a parser would, and frees them all together.
+//
+// Build: gcc -O2 bench_batch.c -o bench_batch -lpthread
+// Usage: ./bench_batch [batch_size] [rounds]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "2021MT10924mmu.h"
+
+static long long clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void touch(void **ptrs, size_t count) {
+    for (size_t i = 0; i < count; i++) *(char *)ptrs[i] = 1;
+}
+
+static double run_single(void *(*alloc)(size_t), void (*release)(void *), size_t size, void **ptrs,
+                         size_t batch, int rounds) {
+    long long start = clock_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < batch; i++) ptrs[i] = alloc(size);
+        touch(ptrs, batch);
+        for (size_t i = 0; i < batch; i++) release(ptrs[i]);
+    }
+    return (double)(clock_ns() - start) / ((double)rounds * batch);
+}
+
+static double run_batch(size_t size, void **ptrs, size_t batch, int rounds) {
+    long long start = clock_ns();
+    for (int r = 0; r < rounds; r++) {
+        if (my_malloc_batch(size, batch, ptrs) != batch) {
+            fprintf(stderr, "my_malloc_batch ran out of memory\n");
+            exit(1);
+        }
+        touch(ptrs, batch);
+        my_free_batch(ptrs, batch);
+    }
+    return (double)(clock_ns() - start) / ((double)rounds * batch);
+}
+
+int main(int argc, char **argv) {
+    size_t batch = argc > 1 ? (size_t)atol(argv[1]) : 4096;
+    int rounds = argc > 2 ? atoi(argv[2]) : 500;
+    if (batch < 1) batch = 1;
+    if (rounds < 1) rounds = 1;
+    void **ptrs = (void **)malloc(batch * sizeof(void *));
+    size_t sizes[] = { 16, 32, 64, 128, 256, 512, 1024, 4096 };
+
+    printf("batch of %zu objects, %d rounds; ns per object (allocate + touch + free)\n", batch, rounds);
+    printf("%8s %12s %12s %12s %10s\n", "size", "my_malloc", "batch", "malloc", "speedup");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size_t size = sizes[i];
+        run_batch(size, ptrs, batch, 1); // Warm up: the arena and slabs for this size exist before timing
+        double single = run_single(my_malloc, my_free, size, ptrs, batch, rounds);
+        double batched = run_batch(size, ptrs, batch, rounds);
+        double system = run_single(malloc, free, size, ptrs, batch, rounds);
+        printf("%8zu %12.1f %12.1f %12.1f %9.2fx\n", size, single, batched, system, single / batched);
+    }
+    free(ptrs);
+    return 0;
+}
@@ -0,0 +1,130 @@
+// Pointer chasing over a heap of small nodes with huge pages off, transparent (thp) and from the
+// hugetlb pool (falling back to thp when the pool is empty). The nodes are linked in one random cycle, so
+// nearly every hop lands on a different page and the cost is dominated by TLB misses once the heap is
+// larger than the TLB reach. Each mode runs in its own child process with HUGEPAGE_ENV set, and reports
+// nanoseconds per hop, dTLB load misses per hop (when perf counters are available) and how much of the
+// heap the kernel backed with huge pages.
+//
+// Build: gcc -O2 bench_hugepage.c -o bench_hugepage -lpthread
+// Usage: ./bench_hugepage [nodes] [node_size] [hops]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <linux/perf_event.h>
+#include "2021MT10924mmu.h"
+
+typedef struct node {
+    struct node *next;
+} node_t;
+
+static node_t *volatile sink; // Keeps the optimizer from dropping the chase
+
+static long long clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static uint64_t xorshift(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// Counter of dTLB load misses for this process, or -1 if perf events are not available
+static int open_dtlb_counter(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// Kilobytes of the process's memory backed by huge pages, transparent or from the hugetlb pool
+static long huge_kb(void) {
+    FILE *f = fopen("/proc/self/smaps_rollup", "r");
+    if (!f) return -1;
+    char line[256];
+    long total = 0, kb;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) total += kb;
+        else if (sscanf(line, "Private_Hugetlb: %ld kB", &kb) == 1) total += kb;
+    }
+    fclose(f);
+    return total;
+}
+
+static void run(const char *mode, size_t nodes, size_t node_size, size_t hops) {
+    setenv(HUGEPAGE_ENV, mode, 1); // Read when the allocator initialises, on the first my_malloc below
+
+    node_t **ptrs = (node_t **)malloc(nodes * sizeof(node_t *));
+    for (size_t i = 0; i < nodes; i++) ptrs[i] = (node_t *)my_malloc(node_size);
+
+    // Sattolo's shuffle gives a single cycle through every node
+    uint64_t state = 88172645463325252ULL;
+    for (size_t i = nodes - 1; i > 0; i--) {
+        size_t j = (size_t)(xorshift(&state) % i);
+        node_t *tmp = ptrs[i];
+        ptrs[i] = ptrs[j];
+        ptrs[j] = tmp;
+    }
+    for (size_t i = 0; i < nodes; i++) ptrs[i]->next = ptrs[(i + 1) % nodes];
+
+    node_t *p = ptrs[0];
+    for (size_t i = 0; i < nodes; i++) p = p->next; // Warm up: every page faulted in
+
+    int counter = open_dtlb_counter();
+    if (counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    long long start = clock_ns();
+    for (size_t i = 0; i < hops; i++) p = p->next;
+    long long elapsed = clock_ns() - start;
+    sink = p;
+    long long misses = -1;
+    if (counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(counter, &misses, sizeof(misses)) != sizeof(misses)) misses = -1;
+        close(counter);
+    }
+
+    char tlb[32] = "n/a";
+    if (misses >= 0) snprintf(tlb, sizeof(tlb), "%.3f", (double)misses / hops);
+    my_mallinfo_t info = my_mallinfo();
+    printf("%-8s %12.2f %14s %14.1f %12.1f\n", mode, (double)elapsed / hops, tlb,
+           (double)huge_kb() / 1024, (double)info.mapped / (1024 * 1024));
+}
+
+int main(int argc, char **argv) {
+    size_t nodes = argc > 1 ? (size_t)atol(argv[1]) : 4 * 1024 * 1024;
+    size_t node_size = argc > 2 ? (size_t)atol(argv[2]) : 64;
+    size_t hops = argc > 3 ? (size_t)atol(argv[3]) : 20 * 1000 * 1000;
+    if (nodes < 2) nodes = 2;
+    if (node_size < sizeof(node_t)) node_size = sizeof(node_t);
+    if (hops < 1) hops = 1;
+
+    printf("%zu nodes of %zu bytes, %zu hops\n", nodes, node_size, hops);
+    printf("%-8s %12s %14s %14s %12s\n", "mode", "ns/hop", "dTLB miss/hop", "huge MiB", "mapped MiB");
+    fflush(stdout);
+    const char *modes[] = { "off", "thp", "hugetlb" };
+    for (int m = 0; m < 3; m++) {
+        pid_t pid = fork(); // A fresh process per mode, so the allocator starts in that mode
+        if (pid == 0) {
+            run(modes[m], nodes, node_size, hops);
+            fflush(stdout);
+            _exit(0);
+        }
+        if (pid > 0) waitpid(pid, NULL, 0);
+    }
+    return 0;
+}
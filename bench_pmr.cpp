@@ -0,0 +1,168 @@
+// Node-based containers on std::allocator against the adapters in mmu_pmr.hpp: mmu::Allocator,
+// std::pmr over mmu::MemoryResource, and std::pmr over a per-container mmu::PoolResource. Workloads:
+//   map  insert, look up and erase random keys in an unordered_map
+//   list push and pop at both ends of a list, keeping it at a steady length
+//   tlb  an LRU TLB as in 2021MT10924.cpp: a hash map from page to a list node, one node per miss
+// Each container is rebuilt every round, so construction and teardown are part of the cost.
+//
+// Build: gcc -O2 -c mmu_impl.c && g++ -std=c++17 -O2 bench_pmr.cpp mmu_impl.o -o bench_pmr -lpthread
+// Usage: ./bench_pmr [elements] [rounds]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <list>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+#include "mmu_pmr.hpp"
+
+using namespace std;
+
+static long long clock_ns() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Keeps the optimizer from dropping the work
+static volatile unsigned long long sink;
+
+template <class Map>
+static void map_workload(Map& map, const vector<unsigned>& keys) {
+    unsigned long long found = 0;
+    for (unsigned key : keys) map[key] = key;
+    for (unsigned key : keys) found += map.count(key ^ 1);
+    for (unsigned key : keys) map.erase(key);
+    sink += found;
+}
+
+template <class List>
+static void list_workload(List& list, const vector<unsigned>& keys) {
+    for (size_t i = 0; i < keys.size() / 4; i++) list.push_back(keys[i]);
+    for (unsigned key : keys) {
+        if (key & 1) {
+            list.push_back(key);
+            list.pop_front();
+        } else {
+            list.push_front(key);
+            list.pop_back();
+        }
+    }
+    sink += list.size();
+}
+
+// LRU TLB with capacity entries; the keys are page numbers
+template <class Map, class List>
+static void tlb_workload(Map& map, List& order, const vector<unsigned>& pages, size_t capacity) {
+    unsigned long long hits = 0;
+    for (unsigned page : pages) {
+        auto it = map.find(page);
+        if (it != map.end()) {
+            order.splice(order.end(), order, it->second);  // Most recently used at the back
+            hits++;
+            continue;
+        }
+        if (map.size() == capacity) {
+            map.erase(order.front());
+            order.pop_front();
+        }
+        order.push_back(page);
+        map[page] = prev(order.end());
+    }
+    sink += hits;
+}
+
+// Nanoseconds per key of body(), run rounds times
+static double time_rounds(const function<void()>& body, int rounds, size_t keys) {
+    body();  // Warm up
+    long long start = clock_ns();
+    for (int r = 0; r < rounds; r++) body();
+    return (double)(clock_ns() - start) / ((double)rounds * keys);
+}
+
+template <class T>
+using mmu_list = list<T, mmu::Allocator<T>>;
+template <class K, class V>
+using mmu_map = unordered_map<K, V, hash<K>, equal_to<K>, mmu::Allocator<pair<const K, V>>>;
+
+static void run_map(const vector<unsigned>& keys, int rounds, double* ns) {
+    ns[0] = time_rounds([&] { unordered_map<unsigned, unsigned> m; map_workload(m, keys); }, rounds, keys.size());
+    ns[1] = time_rounds([&] { mmu_map<unsigned, unsigned> m; map_workload(m, keys); }, rounds, keys.size());
+    ns[2] = time_rounds([&] {
+        pmr::unordered_map<unsigned, unsigned> m(mmu::default_resource());
+        map_workload(m, keys);
+    }, rounds, keys.size());
+    ns[3] = time_rounds([&] {
+        mmu::PoolResource pool;
+        pmr::unordered_map<unsigned, unsigned> m(&pool);
+        map_workload(m, keys);
+    }, rounds, keys.size());
+}
+
+static void run_list(const vector<unsigned>& keys, int rounds, double* ns) {
+    ns[0] = time_rounds([&] { list<unsigned> l; list_workload(l, keys); }, rounds, keys.size());
+    ns[1] = time_rounds([&] { mmu_list<unsigned> l; list_workload(l, keys); }, rounds, keys.size());
+    ns[2] = time_rounds([&] {
+        pmr::list<unsigned> l(mmu::default_resource());
+        list_workload(l, keys);
+    }, rounds, keys.size());
+    ns[3] = time_rounds([&] {
+        mmu::PoolResource pool;
+        pmr::list<unsigned> l(&pool);
+        list_workload(l, keys);
+    }, rounds, keys.size());
+}
+
+static void run_tlb(const vector<unsigned>& pages, int rounds, double* ns) {
+    size_t capacity = 1024;
+    ns[0] = time_rounds([&] {
+        list<unsigned> order;
+        unordered_map<unsigned, list<unsigned>::iterator> map;
+        tlb_workload(map, order, pages, capacity);
+    }, rounds, pages.size());
+    ns[1] = time_rounds([&] {
+        mmu_list<unsigned> order;
+        mmu_map<unsigned, mmu_list<unsigned>::iterator> map;
+        tlb_workload(map, order, pages, capacity);
+    }, rounds, pages.size());
+    ns[2] = time_rounds([&] {
+        pmr::list<unsigned> order(mmu::default_resource());
+        pmr::unordered_map<unsigned, pmr::list<unsigned>::iterator> map(mmu::default_resource());
+        tlb_workload(map, order, pages, capacity);
+    }, rounds, pages.size());
+    ns[3] = time_rounds([&] {
+        mmu::PoolResource pool;
+        pmr::list<unsigned> order(&pool);
+        pmr::unordered_map<unsigned, pmr::list<unsigned>::iterator> map(&pool);
+        tlb_workload(map, order, pages, capacity);
+    }, rounds, pages.size());
+}
+
+int main(int argc, char** argv) {
+    size_t elements = argc > 1 ? (size_t)atol(argv[1]) : 100000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20;
+    if (elements < 4) elements = 4;
+    if (rounds < 1) rounds = 1;
+
+    srand(1);
+    vector<unsigned> keys(elements), pages(elements);
+    for (size_t i = 0; i < elements; i++) {
+        keys[i] = (unsigned)rand();
+        // A working set that drifts through 8192 pages, so the TLB both hits and misses
+        pages[i] = (unsigned)((i / 64 + rand() % 2048) % 8192);
+    }
+
+    printf("%zu elements, %d rounds; ns per element\n", elements, rounds);
+    printf("%-6s %12s %14s %12s %12s %10s\n", "work", "std", "mmu::Alloc", "pmr", "pmr+pool", "best gain");
+    const char* names[] = { "map", "list", "tlb" };
+    for (int w = 0; w < 3; w++) {
+        double ns[4];
+        if (w == 0) run_map(keys, rounds, ns);
+        else if (w == 1) run_list(keys, rounds, ns);
+        else run_tlb(pages, rounds, ns);
+        double best = ns[1];
+        for (int i = 2; i < 4; i++) if (ns[i] < best) best = ns[i];
+        printf("%-6s %12.1f %14.1f %12.1f %12.1f %9.2fx\n", names[w], ns[0], ns[1], ns[2], ns[3], ns[0] / best);
+    }
+    return 0;
+}
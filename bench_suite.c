@@ -0,0 +1,408 @@
+// Allocator benchmark suite: classic workloads run against my_malloc (2021MT10924mmu.h) and the system
+// malloc, each workload and allocator in a fresh child process so neither sees the other's heap or RSS.
+//
+//   larson       server churn: threads replace random objects, then hand their objects to new threads
+//   prodcons     producer/consumer pairs: every object is freed by a thread other than its allocator
+//   powerlaw     churn with power-law distributed sizes (many small objects, a long tail of big ones)
+//   realloc      buffers grown by 1.5x steps up to 4 MiB, as log builders and vectors do
+//   fragment     long run of objects with mixed lifetimes; RSS is sampled over time
+//
+// For each run it reports throughput, p50/p99/p999 latency (every 16th call is timed) and peak RSS;
+// the fragmentation run also reports RSS against live bytes over time. With -j every result is one
+// JSON object per line.
+//
+// Build: gcc -O2 bench_suite.c -o bench_suite -lpthread
+// Usage: ./bench_suite [-j] [-t threads] [-n ops_per_thread] [workload...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "2021MT10924mmu.h"
+
+#define SLOTS 1000           // Live objects per thread in the churn workloads
+#define LATENCY_EVERY 16     // Time one call in this many
+#define RSS_SAMPLES 10       // RSS samples taken during the fragmentation run
+#define RING_SIZE 1024       // Objects in flight between a producer and its consumer
+
+typedef struct allocator {
+    const char *name;
+    void *(*alloc)(size_t);
+    void *(*resize)(void *, size_t);
+    void (*release)(void *);
+} allocator;
+
+// Per-thread state: random generator and the timed latencies
+typedef struct worker {
+    const allocator *a;
+    long ops;
+    uint64_t random;
+    uint32_t *latency;
+    size_t latency_count;
+    pthread_barrier_t *start;
+    void *(*body)(void *);   // Workload the thread runs once released
+    long long begin_ns;      // When the thread was released by the start barrier
+    long long end_ns;        // When its workload returned
+    void **slots;            // larson: objects handed from one generation of threads to the next
+    struct ring *ring;       // prodcons: queue shared with the partner thread
+    int producer;
+} worker;
+
+typedef struct ring {
+    void *items[RING_SIZE];
+    unsigned long head;      // Next slot the producer fills
+    unsigned long tail;      // Next slot the consumer empties
+} ring;
+
+static int json = 0;
+static int threads = 4;
+static long ops_per_thread = 1000000;
+
+static long long clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static uint64_t next_random(worker *w) {
+    uint64_t x = w->random; // xorshift64
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return w->random = x;
+}
+
+static long rss_kb(void) {
+    long pages = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        fclose(f);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static long peak_rss_kb(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Allocate, touching the first byte as a real program would; every LATENCY_EVERY-th call is timed
+static void *timed_alloc(worker *w, long i, size_t size) {
+    if (i % LATENCY_EVERY) {
+        void *ptr = w->a->alloc(size);
+        *(char *)ptr = 1;
+        return ptr;
+    }
+    long long start = clock_ns();
+    void *ptr = w->a->alloc(size);
+    w->latency[w->latency_count++] = (uint32_t)(clock_ns() - start);
+    *(char *)ptr = 1;
+    return ptr;
+}
+
+static void timed_free(worker *w, long i, void *ptr) {
+    if (i % LATENCY_EVERY) {
+        w->a->release(ptr);
+        return;
+    }
+    long long start = clock_ns();
+    w->a->release(ptr);
+    w->latency[w->latency_count++] = (uint32_t)(clock_ns() - start);
+}
+
+// Larson: replace random objects of 16..1024 bytes; objects outlive the thread that allocated them
+static void *larson_worker(void *arg) {
+    worker *w = (worker *)arg;
+    for (long i = 0; i < w->ops; i++) {
+        size_t slot = next_random(w) % SLOTS;
+        if (w->slots[slot]) timed_free(w, i, w->slots[slot]);
+        w->slots[slot] = timed_alloc(w, i, 16 + next_random(w) % 1009);
+    }
+    return NULL;
+}
+
+// Power law: P(size > s) falls as 1/s from 16 bytes, capped at 1 MiB
+static void *powerlaw_worker(void *arg) {
+    worker *w = (worker *)arg;
+    void *slots[SLOTS] = { NULL };
+    for (long i = 0; i < w->ops; i++) {
+        size_t slot = next_random(w) % SLOTS;
+        if (slots[slot]) {
+            timed_free(w, i, slots[slot]);
+            slots[slot] = NULL;
+        } else {
+            double u = ((next_random(w) >> 11) + 1) * (1.0 / 9007199254740993.0);
+            double size = 16.0 / u;
+            slots[slot] = timed_alloc(w, i, size > 1048576.0 ? 1048576 : (size_t)size);
+        }
+    }
+    for (int i = 0; i < SLOTS; i++) {
+        if (slots[i]) w->a->release(slots[i]);
+    }
+    return NULL;
+}
+
+// Producer/consumer: the producer allocates 16..512 bytes and queues them; the consumer frees them
+static void *prodcons_worker(void *arg) {
+    worker *w = (worker *)arg;
+    ring *r = w->ring;
+    for (long i = 0; i < w->ops; i++) {
+        if (w->producer) {
+            while (i >= (long)__atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) + RING_SIZE) sched_yield();
+            r->items[i % RING_SIZE] = timed_alloc(w, i, 16 + next_random(w) % 497);
+            __atomic_store_n(&r->head, (unsigned long)i + 1, __ATOMIC_RELEASE);
+        } else {
+            while (i >= (long)__atomic_load_n(&r->head, __ATOMIC_ACQUIRE)) sched_yield();
+            timed_free(w, i, r->items[i % RING_SIZE]);
+            __atomic_store_n(&r->tail, (unsigned long)i + 1, __ATOMIC_RELEASE);
+        }
+    }
+    return NULL;
+}
+
+// Realloc growth: grow a buffer from 16 bytes to 4 MiB in 1.5x steps, writing each new tail, then drop it
+static void *realloc_worker(void *arg) {
+    worker *w = (worker *)arg;
+    char *buffer = NULL;
+    size_t size = 0;
+    for (long i = 0; i < w->ops; i++) {
+        size_t grown = size < 16 ? 16 : size + size / 2;
+        if (grown > 4 << 20) {
+            w->a->release(buffer);
+            buffer = NULL;
+            size = 0;
+            continue;
+        }
+        long long start = i % LATENCY_EVERY ? 0 : clock_ns();
+        buffer = (char *)w->a->resize(buffer, grown);
+        if (start) w->latency[w->latency_count++] = (uint32_t)(clock_ns() - start);
+        memset(buffer + size, (int)i, grown - size);
+        size = grown;
+    }
+    w->a->release(buffer);
+    return NULL;
+}
+
+static int by_value(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Print one result line: calls/s, latency percentiles and peak RSS, plus any extra JSON fields
+static void report(const char *workload, const allocator *a, worker *w, int count, long long elapsed_ns,
+                   long base_rss, const char *extra_json, const char *extra_text) {
+    size_t n = 0, calls = 0;
+    for (int t = 0; t < count; t++) n += w[t].latency_count;
+    uint32_t *all = (uint32_t *)malloc((n + 1) * sizeof(uint32_t));
+    for (int t = 0, k = 0; t < count; t++) {
+        memcpy(all + k, w[t].latency, w[t].latency_count * sizeof(uint32_t));
+        k += (int)w[t].latency_count;
+        calls += (size_t)w[t].ops;
+    }
+    qsort(all, n, sizeof(uint32_t), by_value);
+    uint32_t p50 = n ? all[n / 2] : 0, p99 = n ? all[n * 99 / 100] : 0, p999 = n ? all[n * 999 / 1000] : 0;
+    double rate = calls / (elapsed_ns / 1e9);
+    long rss = peak_rss_kb() - base_rss;
+
+    if (json) {
+        printf("{\"workload\":\"%s\",\"allocator\":\"%s\",\"threads\":%d,\"calls\":%zu,\"calls_per_sec\":%.0f,"
+               "\"p50_ns\":%u,\"p99_ns\":%u,\"p999_ns\":%u,\"peak_rss_kb\":%ld%s}\n",
+               workload, a->name, count, calls, rate, p50, p99, p999, rss, extra_json);
+    } else {
+        printf("%-10s %-10s %8d %14.0f %8u %8u %8u %12ld %s\n", workload, a->name, count, rate, p50, p99,
+               p999, rss, extra_text);
+    }
+    fflush(stdout);
+    free(all);
+}
+
+static worker *make_workers(const allocator *a, int count, long ops, pthread_barrier_t *start) {
+    worker *w = (worker *)calloc((size_t)count, sizeof(worker));
+    for (int t = 0; t < count; t++) {
+        w[t].a = a;
+        w[t].ops = ops;
+        w[t].random = 0x9E3779B97F4A7C15ULL * (uint64_t)(t + 1);
+        w[t].latency = (uint32_t *)malloc((size_t)(ops / LATENCY_EVERY + 1) * 2 * sizeof(uint32_t)); // A free and an alloc per call index
+        w[t].start = start;
+    }
+    return w;
+}
+
+// Thread start: wait for the other workers, then time the workload on the thread's own clock reads
+static void *run_worker(void *arg) {
+    worker *w = (worker *)arg;
+    pthread_barrier_wait(w->start);
+    w->begin_ns = clock_ns();
+    w->body(w);
+    w->end_ns = clock_ns();
+    return NULL;
+}
+
+// Start count threads on fn, release them together and return the time from the first worker's start
+// to the last one's finish. Workers read the clock themselves: they may be done before this thread,
+// released by the same barrier, gets to run again.
+static long long run_threads(void *(*fn)(void *), worker *w, int count, pthread_barrier_t *start) {
+    pthread_t tids[count];
+    for (int t = 0; t < count; t++) {
+        w[t].body = fn;
+        pthread_create(&tids[t], NULL, run_worker, &w[t]);
+    }
+    pthread_barrier_wait(start);
+    for (int t = 0; t < count; t++) pthread_join(tids[t], NULL);
+    long long begin = w[0].begin_ns, end = w[0].end_ns;
+    for (int t = 1; t < count; t++) {
+        if (w[t].begin_ns < begin) begin = w[t].begin_ns;
+        if (w[t].end_ns > end) end = w[t].end_ns;
+    }
+    return end - begin;
+}
+
+static void bench_threads(const char *workload, const allocator *a, void *(*fn)(void *), int count) {
+    long base_rss = peak_rss_kb();
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, count + 1);
+    worker *w = make_workers(a, count, ops_per_thread, &start);
+    long long elapsed = run_threads(fn, w, count, &start);
+    report(workload, a, w, count, elapsed, base_rss, "", "");
+}
+
+// Larson: three generations of threads share the same object arrays, so every generation frees
+// objects the previous one allocated
+static void bench_larson(const allocator *a) {
+    long base_rss = peak_rss_kb();
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, threads + 1);
+    worker *w = make_workers(a, threads, ops_per_thread, &start);
+    for (int t = 0; t < threads; t++) {
+        w[t].ops /= 3;
+        w[t].slots = (void **)calloc(SLOTS, sizeof(void *));
+    }
+    long long elapsed = 0;
+    for (int generation = 0; generation < 3; generation++) elapsed += run_threads(larson_worker, w, threads, &start);
+    for (int t = 0; t < threads; t++) {
+        w[t].ops *= 3;
+        for (int i = 0; i < SLOTS; i++) {
+            if (w[t].slots[i]) a->release(w[t].slots[i]);
+        }
+    }
+    report("larson", a, w, threads, elapsed, base_rss, "", "");
+}
+
+static void bench_prodcons(const allocator *a) {
+    int pairs = threads / 2 > 0 ? threads / 2 : 1;
+    long base_rss = peak_rss_kb();
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, 2 * pairs + 1);
+    worker *w = make_workers(a, 2 * pairs, ops_per_thread, &start);
+    for (int p = 0; p < pairs; p++) {
+        ring *r = (ring *)calloc(1, sizeof(ring));
+        w[2 * p].ring = w[2 * p + 1].ring = r;
+        w[2 * p].producer = 1;
+    }
+    long long elapsed = run_threads(prodcons_worker, w, 2 * pairs, &start);
+    report("prodcons", a, w, 2 * pairs, elapsed, base_rss, "", "");
+}
+
+// Fragmentation: one thread keeps a pool of objects whose lifetimes mix short and long, with sizes
+// drifting over time so freed holes rarely fit new requests exactly. RSS is compared to the live bytes.
+static void bench_fragment(const allocator *a) {
+    long base_rss = peak_rss_kb();
+    long base_now = rss_kb();
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, 1);
+    worker *w = make_workers(a, 1, ops_per_thread, &start);
+    enum { POOL = 20000 };
+    void **pool = (void **)calloc(POOL, sizeof(void *));
+    size_t *sizes = (size_t *)calloc(POOL, sizeof(size_t));
+    size_t live = 0;
+    long interval = w->ops / RSS_SAMPLES > 0 ? w->ops / RSS_SAMPLES : 1;
+    double ratio[RSS_SAMPLES];
+    int samples = 0;
+
+    long long begin = clock_ns();
+    for (long i = 0; i < w->ops; i++) {
+        if (i && i % interval == 0 && samples < RSS_SAMPLES - 1) {
+            ratio[samples++] = (double)((rss_kb() - base_now) * 1024) / (double)(live ? live : 1);
+        }
+        // Objects in the first tenth of the pool are long-lived; the rest turn over quickly
+        size_t slot = next_random(w) % 10 ? POOL / 10 + next_random(w) % (POOL - POOL / 10) : next_random(w) % (POOL / 10);
+        if (slot < POOL / 10 && pool[slot] && next_random(w) % 50) continue; // Long-lived objects rarely die
+        if (pool[slot]) {
+            timed_free(w, i, pool[slot]);
+            live -= sizes[slot];
+        }
+        size_t phase = (size_t)(i * 8 / (w->ops + 1)); // Sizes drift through eight phases
+        sizes[slot] = 16 + (phase * 512 + next_random(w) % 4096) % 8192;
+        pool[slot] = timed_alloc(w, i, sizes[slot]);
+        live += sizes[slot];
+    }
+    long long elapsed = clock_ns() - begin;
+    ratio[samples++] = (double)((rss_kb() - base_now) * 1024) / (double)(live ? live : 1);
+
+    char json_extra[512] = ",\"rss_over_live\":[", text_extra[512] = "rss/live:";
+    for (int k = 0; k < samples; k++) {
+        size_t json_len = strlen(json_extra), text_len = strlen(text_extra);
+        snprintf(json_extra + json_len, sizeof(json_extra) - json_len, "%s%.2f", k ? "," : "", ratio[k]);
+        snprintf(text_extra + text_len, sizeof(text_extra) - text_len, " %.2f", ratio[k]);
+    }
+    strcat(json_extra, "]");
+    for (int i = 0; i < POOL; i++) {
+        if (pool[i]) a->release(pool[i]);
+    }
+    report("fragment", a, w, 1, elapsed, base_rss, json_extra, text_extra);
+}
+
+static void run_workload(const char *name, const allocator *a) {
+    if (!strcmp(name, "larson")) bench_larson(a);
+    else if (!strcmp(name, "prodcons")) bench_prodcons(a);
+    else if (!strcmp(name, "powerlaw")) bench_threads("powerlaw", a, powerlaw_worker, threads);
+    else if (!strcmp(name, "realloc")) bench_threads("realloc", a, realloc_worker, threads);
+    else if (!strcmp(name, "fragment")) bench_fragment(a);
+    else fprintf(stderr, "unknown workload %s\n", name);
+}
+
+int main(int argc, char **argv) {
+    const char *all[] = { "larson", "prodcons", "powerlaw", "realloc", "fragment" };
+    const char **workloads = all;
+    int workload_count = 5;
+    int opt;
+    while ((opt = getopt(argc, argv, "jt:n:")) != -1) {
+        if (opt == 'j') json = 1;
+        else if (opt == 't') threads = atoi(optarg) > 0 ? atoi(optarg) : 1;
+        else if (opt == 'n') ops_per_thread = atol(optarg) > 0 ? atol(optarg) : 1;
+        else {
+            fprintf(stderr, "usage: %s [-j] [-t threads] [-n ops_per_thread] [workload...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind < argc) {
+        workloads = (const char **)(argv + optind);
+        workload_count = argc - optind;
+    }
+
+    allocator allocators[] = {
+        { "my_malloc", my_malloc, my_realloc, my_free },
+        { "malloc", malloc, realloc, free },
+    };
+    if (!json) {
+        printf("%-10s %-10s %8s %14s %8s %8s %8s %12s\n", "workload", "allocator", "threads", "calls/s",
+               "p50_ns", "p99_ns", "p999_ns", "peak_rss_kb");
+        fflush(stdout);
+    }
+    for (int i = 0; i < workload_count; i++) {
+        for (size_t k = 0; k < sizeof(allocators) / sizeof(allocators[0]); k++) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                run_workload(workloads[i], &allocators[k]);
+                _exit(0);
+            }
+            waitpid(pid, NULL, 0);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Multithreaded scaling benchmark for the allocator in 2021MT10924mmu.h.
+// Every thread churns its own set of small blocks (malloc/free of random sizes between 1 and 512 bytes),
+// so the thread caches should let throughput grow with the number of threads.
+//
+// Build: gcc -O2 bench_threads.c -o bench_threads -lpthread
+// Usage: ./bench_threads [max_threads] [ops_per_thread]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "2021MT10924mmu.h"
+
+#define SLOTS 1000 // Live blocks per thread, as in stress_test in checker_easy.c
+
+typedef struct {
+    void *(*alloc)(size_t);
+    void (*release)(void *);
+    long ops;
+    unsigned int seed;
+    pthread_barrier_t *start;
+} worker_args;
+
+// Wall-clock time in seconds (clock() would add up CPU time across threads)
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Randomly allocate into empty slots and free occupied ones
+static void *worker(void *arg) {
+    worker_args *w = (worker_args *)arg;
+    void *slots[SLOTS] = { NULL };
+    unsigned int seed = w->seed;
+
+    pthread_barrier_wait(w->start);
+    for (long i = 0; i < w->ops; i++) {
+        int slot = rand_r(&seed) % SLOTS;
+        if (slots[slot]) {
+            w->release(slots[slot]);
+            slots[slot] = NULL;
+        } else {
+            size_t size = (rand_r(&seed) % 512) + 1;
+            slots[slot] = w->alloc(size);
+            *(char *)slots[slot] = 1; // Touch the block so it is really used
+        }
+    }
+    for (int i = 0; i < SLOTS; i++) {
+        if (slots[i]) w->release(slots[i]);
+    }
+    return NULL;
+}
+
+// Run the workload on the given number of threads and return the throughput in million ops/sec
+static double run(int threads, long ops, void *(*alloc)(size_t), void (*release)(void *)) {
+    pthread_t tids[threads];
+    worker_args args[threads];
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, threads + 1);
+
+    for (int t = 0; t < threads; t++) {
+        args[t].alloc = alloc;
+        args[t].release = release;
+        args[t].ops = ops;
+        args[t].seed = 12345u + t;
+        args[t].start = &start;
+        pthread_create(&tids[t], NULL, worker, &args[t]);
+    }
+
+    pthread_barrier_wait(&start);
+    double begin = now_seconds();
+    for (int t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    double elapsed = now_seconds() - begin;
+
+    pthread_barrier_destroy(&start);
+    return threads * ops / elapsed / 1e6;
+}
+
+int main(int argc, char **argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    long ops = argc > 2 ? atol(argv[2]) : 2000000;
+    if (max_threads < 1) max_threads = 1;
+
+    printf("%-8s %14s %10s %14s %10s\n", "threads", "my_malloc", "speedup", "malloc", "speedup");
+    double mine_base = 0, libc_base = 0;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double mine = run(threads, ops, my_malloc, my_free);
+        double libc = run(threads, ops, malloc, free);
+        if (threads == 1) {
+            mine_base = mine;
+            libc_base = libc;
+        }
+        printf("%-8d %9.2f Mop/s %9.2fx %9.2f Mop/s %9.2fx\n",
+               threads, mine, mine / mine_base, libc, libc / libc_base);
+        if (threads < max_threads && threads * 2 > max_threads) threads = max_threads / 2; // Always finish at max_threads
+    }
+    return 0;
+}
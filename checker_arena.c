@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <time.h>
+#include "my_mmu.h"
+
+// Checks of bump arenas: allocation, marks, rewind and reset.
+//
+// Build: gcc -O2 checker_arena.c -o checker_arena -lpthread
+
+// Timer function to calculate elapsed time
+double calculate_time_taken(clock_t start, clock_t end) {
+    return ((double)(end - start)) / CLOCKS_PER_SEC;
+}
+
+// Whether size bytes at ptr all hold value
+static int filled_with(const void* ptr, size_t size, unsigned char value) {
+    const unsigned char* bytes = (const unsigned char*)ptr;
+    for (size_t i = 0; i < size; i++) {
+        if (bytes[i] != value) return 0;
+    }
+    return 1;
+}
+
+// Bump arenas: my_arena_rewind puts the cursor back at the mark, even across chunks
+void test_arena_rewind() {
+    printf("Testing bump arenas...\n");
+    clock_t start = clock();
+
+    my_arena_t* arena = my_arena_create();
+    assert(arena);
+    char* first = (char*)my_arena_alloc(arena, 100);
+    assert(first);
+    memset(first, 0x33, 100);
+
+    my_arena_mark_t mark = my_arena_mark(arena);
+    char* after_mark = (char*)my_arena_alloc(arena, 64);
+    for (int i = 0; i < 1000; i++) assert(my_arena_alloc(arena, 10000)); // Several chunks' worth
+    my_arena_rewind(arena, mark);
+    assert(my_arena_alloc(arena, 64) == after_mark);
+    assert(filled_with(first, 100, 0x33)); // Memory from before the mark is untouched
+
+    char* aligned = (char*)my_arena_alloc_aligned(arena, 4096, 10);
+    assert(aligned && (uintptr_t)aligned % 4096 == 0);
+
+    my_arena_reset(arena);
+    assert(my_arena_alloc(arena, 100) == first);
+    my_arena_destroy(arena);
+    printf("Arena rewind and reset restored the cursor.\n");
+
+    clock_t end = clock();
+    printf("Time taken for test_arena_rewind: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+// A rewind to a mark in an earlier chunk keeps the later chunks for reuse instead of mapping new ones
+void test_arena_reuse() {
+    printf("Testing bump arena chunk reuse...\n");
+    clock_t start = clock();
+
+    my_arena_t* arena = my_arena_create();
+    assert(arena);
+    my_arena_mark_t mark = my_arena_mark(arena);
+    size_t maps = my_mallinfo().mmap_calls;
+    for (int round = 0; round < 100; round++) {
+        for (int i = 0; i < 100; i++) {
+            char* ptr = (char*)my_arena_alloc(arena, 5000);
+            assert(ptr);
+            memset(ptr, round, 5000);
+        }
+        if (round == 0) maps = my_mallinfo().mmap_calls;
+        my_arena_rewind(arena, mark);
+    }
+    assert(my_mallinfo().mmap_calls == maps); // Only the first round mapped chunks
+    my_arena_destroy(arena);
+    printf("Rewound arenas reused their chunks.\n");
+
+    clock_t end = clock();
+    printf("Time taken for test_arena_reuse: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+int main() {
+    test_arena_rewind();
+    test_arena_reuse();
+    printf("All arena checks passed.\n");
+    return 0;
+}
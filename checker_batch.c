@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <time.h>
+#include "my_mmu.h"
+
+// Checks of my_malloc_batch and my_free_batch. Build it with -DMALLOC_ALIGNMENT=16 as well: batches
+// must keep the alignment my_malloc has.
+//
+// Build: gcc -O2 checker_batch.c -o checker_batch -lpthread
+//        gcc -O2 -DMALLOC_ALIGNMENT=16 checker_batch.c -o checker_batch16 -lpthread
+
+// Timer function to calculate elapsed time
+double calculate_time_taken(clock_t start, clock_t end) {
+    return ((double)(end - start)) / CLOCKS_PER_SEC;
+}
+
+// Whether size bytes at ptr all hold value
+static int filled_with(const void* ptr, size_t size, unsigned char value) {
+    const unsigned char* bytes = (const unsigned char*)ptr;
+    for (size_t i = 0; i < size; i++) {
+        if (bytes[i] != value) return 0;
+    }
+    return 1;
+}
+
+// my_malloc_batch hands out distinct usable objects at the alignment my_malloc has; my_free_batch gives them back
+void test_batch() {
+    printf("Testing batch allocation...\n");
+    clock_t start = clock();
+
+    size_t sizes[] = { 24, 200, 480, 3000, 200000 };
+    void* ptrs[500];
+    for (int s = 0; s < 5; s++) {
+        size_t size = sizes[s];
+        size_t n = my_malloc_batch(size, 500, ptrs);
+        assert(n == 500);
+        for (size_t i = 0; i < n; i++) {
+            assert(ptrs[i] && my_malloc_usable_size(ptrs[i]) >= size);
+            assert((uintptr_t)ptrs[i] % MALLOC_ALIGNMENT == 0);
+            memset(ptrs[i], (int)i, size);
+        }
+        for (size_t i = 0; i < n; i++) {
+            assert(filled_with(ptrs[i], size, (unsigned char)i)); // No two objects overlap
+        }
+        my_free(ptrs[3]); // Batch objects can also be freed one by one
+        ptrs[3] = NULL;   // NULL entries are skipped
+        my_free_batch(ptrs, n);
+    }
+    assert(my_malloc_batch(0, 10, ptrs) == 0);
+    printf("Batches were distinct, aligned and freed.\n");
+
+    clock_t end = clock();
+    printf("Time taken for test_batch: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+int main() {
+    test_batch();
+    printf("All batch checks passed.\n");
+    return 0;
+}
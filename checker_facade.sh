@@ -0,0 +1,27 @@
+#!/bin/sh
+# Runs checker_easy.c against mmu_facade.cpp built with each Fit / Backend combination of mmu_policy.hpp.
+# checker_easy.c includes "my_mmu.h", which here is a stand-in for mmu_facade.h in a scratch directory.
+#
+# Usage: sh checker_facade.sh   (from the directory holding the sources)
+
+set -e
+src=$(pwd)
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+echo '#include "mmu_facade.h"' > "$dir/my_mmu.h"
+gcc -O2 -I"$dir" -I"$src" -c "$src/checker_easy.c" -o "$dir/checker_easy.o"
+
+for fit in FirstFit BestFit; do
+    for backend in SbrkBackend 'MmapBackend<>'; do
+        echo "Checking mmu::$fit with mmu::$backend..."
+        g++ -std=c++17 -O2 -c "$src/mmu_facade.cpp" -o "$dir/mmu_facade.o" \
+            "-DMMU_FIT=mmu::$fit" "-DMMU_BACKEND=mmu::$backend"
+        g++ "$dir/checker_easy.o" "$dir/mmu_facade.o" -o "$dir/checker_easy" -lpthread
+        "$dir/checker_easy" > "$dir/output"
+        if grep -qiE "fail|error" "$dir/output"; then
+            grep -iE "fail|error" "$dir/output"
+            exit 1
+        fi
+    done
+done
+echo "All facade checks passed."
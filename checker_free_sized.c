@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <time.h>
+#include "my_mmu.h"
+
+// Checks of my_free_sized and my_malloc_usable_size.
+//
+// Build: gcc -O2 checker_free_sized.c -o checker_free_sized -lpthread
+
+// Timer function to calculate elapsed time
+double calculate_time_taken(clock_t start, clock_t end) {
+    return ((double)(end - start)) / CLOCKS_PER_SEC;
+}
+
+// my_free_sized frees like my_free, and the usable size covers at least what was requested
+void test_free_sized() {
+    printf("Testing sized frees and usable sizes...\n");
+    clock_t start = clock();
+
+    assert(my_malloc_usable_size(NULL) == 0);
+    size_t sizes[] = { 1, 24, 200, 480, 3000, 200000 };
+    void* ptrs[500];
+    for (int s = 0; s < 6; s++) {
+        size_t size = sizes[s];
+        for (size_t i = 0; i < 500; i++) {
+            ptrs[i] = my_malloc(size);
+            assert(ptrs[i] && my_malloc_usable_size(ptrs[i]) >= size);
+            memset(ptrs[i], 0x66, my_malloc_usable_size(ptrs[i])); // The whole usable size may be written
+        }
+        for (size_t i = 0; i < 500; i++) my_free_sized(ptrs[i], size);
+
+        void* again = my_malloc(size);
+        assert(again);
+        int reused = 0;
+        for (size_t i = 0; i < 500; i++) reused |= again == ptrs[i];
+        assert(reused); // Sized frees went back to the allocator
+        my_free(again);
+    }
+    my_free_sized(NULL, 10);
+    printf("Sized frees released their objects.\n");
+
+    clock_t end = clock();
+    printf("Time taken for test_free_sized: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+int main() {
+    test_free_sized();
+    printf("All sized free checks passed.\n");
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "my_mmu.h"
+
+// Checks of the huge page modes. Each mode runs in its own child process with HUGEPAGE_ENV set before
+// the allocator starts: objects of every size must work, and slab regions must be mapped in whole huge
+// pages and given back whole by my_malloc_trim.
+//
+// Build: gcc -O2 checker_hugepage.c -o checker_hugepage -lpthread
+
+// Timer function to calculate elapsed time
+double calculate_time_taken(clock_t start, clock_t end) {
+    return ((double)(end - start)) / CLOCKS_PER_SEC;
+}
+
+// Allocate count blocks of size bytes, fill them and check them, then free them all
+static void fill_and_free(void** ptrs, int count, size_t size) {
+    for (int i = 0; i < count; i++) {
+        ptrs[i] = my_malloc(size);
+        assert(ptrs[i]);
+        memset(ptrs[i], i & 0xff, size);
+    }
+    for (int i = 0; i < count; i++) {
+        assert(((unsigned char*)ptrs[i])[size - 1] == (i & 0xff));
+        my_free(ptrs[i]);
+    }
+}
+
+// Runs in the child, before anything else has been allocated
+static void check_mode(const char* name, int mode) {
+    static void* ptrs[40000];
+    size_t base = my_mallinfo().mapped; // Starts the allocator, which reads HUGEPAGE_ENV
+    assert(hugepage_mode == mode);
+
+    // Slab objects: their regions are whole huge pages, and go back whole once empty
+    for (int i = 0; i < 40000; i++) {
+        ptrs[i] = my_malloc(i % 2 ? 24 : 200);
+        assert(ptrs[i]);
+        memset(ptrs[i], 0x11, i % 2 ? 24 : 200);
+    }
+    size_t slabs = my_mallinfo().mapped - base;
+    for (int i = 0; i < 40000; i++) my_free(ptrs[i]);
+    my_malloc_trim();
+    size_t trimmed = my_mallinfo().mapped;
+    printf("%s: slabs mapped %zu KB, %zu KB left after trimming.\n", name, slabs / 1024, (trimmed - base) / 1024);
+    fflush(stdout);
+    if (mode != HUGEPAGE_OFF) assert(slabs % HUGE_PAGE_SIZE == 0);
+    assert(trimmed == base);
+
+    // Arena blocks and dedicated mappings
+    fill_and_free(ptrs, 2000, 3000);
+    fill_and_free(ptrs, 2000, 60000);
+    fill_and_free(ptrs, 10, 3 * 1024 * 1024);
+}
+
+void test_hugepage_modes() {
+    printf("Testing huge page modes...\n");
+    clock_t start = clock();
+
+    const char* names[] = { "off", "thp", "hugetlb" };
+    int modes[] = { HUGEPAGE_OFF, HUGEPAGE_THP, HUGEPAGE_HUGETLB };
+    for (int m = 0; m < 3; m++) {
+        fflush(stdout);
+        pid_t pid = fork();
+        assert(pid >= 0);
+        if (pid == 0) {
+            setenv(HUGEPAGE_ENV, names[m], 1);
+            check_mode(names[m], modes[m]);
+            fflush(stdout);
+            _exit(0);
+        }
+        int status;
+        assert(waitpid(pid, &status, 0) == pid);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    printf("Every huge page mode worked.\n");
+
+    clock_t end = clock();
+    printf("Time taken for test_hugepage_modes: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+int main() {
+    test_hugepage_modes();
+    printf("All huge page checks passed.\n");
+    return 0;
+}
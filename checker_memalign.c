@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include "my_mmu.h"
+
+// Checks of aligned allocation: my_memalign, my_posix_memalign and my_aligned_alloc, with my_realloc
+// and my_free, and the leading padding that aligned blocks give back.
+//
+// Build: gcc -O2 checker_memalign.c -o checker_memalign -lpthread
+
+// Timer function to calculate elapsed time
+double calculate_time_taken(clock_t start, clock_t end) {
+    return ((double)(end - start)) / CLOCKS_PER_SEC;
+}
+
+// Whether size bytes at ptr all hold value
+static int filled_with(const void* ptr, size_t size, unsigned char value) {
+    const unsigned char* bytes = (const unsigned char*)ptr;
+    for (size_t i = 0; i < size; i++) {
+        if (bytes[i] != value) return 0;
+    }
+    return 1;
+}
+
+// my_memalign results keep their alignment through a shrinking my_realloc and their contents through a growing one
+void test_memalign_realloc() {
+    printf("Testing my_memalign with my_realloc...\n");
+    clock_t start = clock();
+
+    size_t alignments[] = { 16, 64, 256, 4096, 65536 };
+    for (int i = 0; i < 5; i++) {
+        size_t alignment = alignments[i];
+        char* ptr = (char*)my_memalign(alignment, 1000);
+        assert(ptr && (uintptr_t)ptr % alignment == 0);
+        memset(ptr, 0x5A, 1000);
+
+        char* shrunk = (char*)my_realloc(ptr, 300);
+        assert(shrunk == ptr); // Shrinking stays in place, so the alignment is kept
+        assert(filled_with(shrunk, 300, 0x5A));
+
+        char* grown = (char*)my_realloc(shrunk, 300000);
+        assert(grown && filled_with(grown, 300, 0x5A));
+        my_free(grown);
+    }
+    assert(my_memalign(3 * 16, 100) == NULL); // Not a power of two
+    printf("Aligned blocks kept their alignment and contents.\n");
+
+    clock_t end = clock();
+    printf("Time taken for test_memalign_realloc: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+
+
+
+// The POSIX and C11 entry points: alignments that are not powers of two (or below a pointer for POSIX)
+// are rejected, and memory running out is reported
+void test_posix_and_c11() {
+    printf("Testing my_posix_memalign and my_aligned_alloc...\n");
+    clock_t start = clock();
+
+    void* ptr = NULL;
+    assert(my_posix_memalign(&ptr, 128, 5000) == 0 && ptr && (uintptr_t)ptr % 128 == 0);
+    my_free(ptr);
+    assert(my_posix_memalign(&ptr, 4, 100) == EINVAL);  // Below sizeof(void*)
+    assert(my_posix_memalign(&ptr, 96, 100) == EINVAL); // Not a power of two
+    assert(my_posix_memalign(&ptr, 64, SIZE_MAX - 4096) == ENOMEM);
+
+    char* c11 = (char*)my_aligned_alloc(1024, 3000);
+    assert(c11 && (uintptr_t)c11 % 1024 == 0);
+    memset(c11, 0x77, 3000);
+    my_free(c11);
+    printf("POSIX and C11 aligned allocation worked.\n");
+
+    clock_t end = clock();
+    printf("Time taken for test_posix_and_c11: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+// The padding in front of an aligned block is split off as a free block, so it serves later
+// allocations instead of being wasted
+void test_padding_reused() {
+    printf("Testing reuse of aligned blocks' padding...\n");
+    clock_t start = clock();
+
+    void* aligned[2000];
+    void* fillers[2000];
+    for (int i = 0; i < 2000; i++) {
+        aligned[i] = my_memalign(4096, 64);
+        assert(aligned[i] && (uintptr_t)aligned[i] % 4096 == 0);
+    }
+    size_t mapped = my_mallinfo().mapped;
+    for (int i = 0; i < 2000; i++) {
+        fillers[i] = my_malloc(3000); // Fits in the ~4 KB of padding before each aligned block
+        assert(fillers[i]);
+    }
+    size_t grown = my_mallinfo().mapped - mapped;
+    if (grown < 1024 * 1024) {
+        printf("Padding of aligned blocks was reused.\n");
+    } else {
+        printf("Padding of aligned blocks was wasted (%zu bytes mapped for the fillers)!\n", grown);
+    }
+    assert(grown < 1024 * 1024);
+    for (int i = 0; i < 2000; i++) {
+        my_free(aligned[i]);
+        my_free(fillers[i]);
+    }
+
+    clock_t end = clock();
+    printf("Time taken for test_padding_reused: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+int main() {
+    test_memalign_realloc();
+    test_posix_and_c11();
+    test_padding_reused();
+    printf("All aligned allocation checks passed.\n");
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <vector>
+#include "mmu_pmr.hpp"
+
+// Checks of the std::pmr adapters: PoolResource behind containers, the leftover end of each chunk being
+// reused, and the shared resource's alignment.
+//
+// Build: gcc -O2 -c mmu_impl.c && g++ -std=c++17 -O2 checker_pmr.cpp mmu_impl.o -o checker_pmr -lpthread
+
+// Timer function to calculate elapsed time
+double calculate_time_taken(clock_t start, clock_t end) {
+    return ((double)(end - start)) / CLOCKS_PER_SEC;
+}
+
+// PoolResource and the shared resource behind std::pmr containers
+void test_pmr() {
+    printf("Testing std::pmr adapters...\n");
+    clock_t start = clock();
+
+    {
+        mmu::PoolResource pool;
+        std::pmr::vector<int> values(&pool);
+        for (int i = 0; i < 10000; i++) values.push_back(i);
+        for (int i = 0; i < 10000; i++) assert(values[i] == i);
+        std::pmr::map<int, int> nodes(&pool);
+        for (int i = 0; i < 10000; i++) nodes[i] = -i;
+        for (int i = 0; i < 10000; i++) assert(nodes[i] == -i);
+    }
+    void* empty = mmu::default_resource()->allocate(0, 64);
+    assert(empty && reinterpret_cast<uintptr_t>(empty) % 64 == 0);
+    mmu::default_resource()->deallocate(empty, 0, 64);
+    printf("std::pmr containers worked.\n");
+
+    clock_t end = clock();
+    printf("Time taken for test_pmr: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+// When a chunk cannot fit the next object, its unused end is handed out to the smaller class it fits
+void test_chunk_tail() {
+    printf("Testing reuse of chunk tails...\n");
+    clock_t start = clock();
+
+    mmu::PoolResource pool;
+    std::vector<char*> large;
+    char* first = static_cast<char*>(pool.allocate(256, 16));
+    large.push_back(first);
+    // 4096-byte first chunk, 16 of it taken by the chunk header: 15 objects of 256 leave a 240-byte tail
+    for (int i = 1; i < 16; i++) large.push_back(static_cast<char*>(pool.allocate(256, 16)));
+    char* tail = static_cast<char*>(pool.allocate(240, 16));
+    assert(tail >= first && tail < first + 4096); // Came from the first chunk, not a new one
+    for (char* ptr : large) assert(tail < ptr || tail >= ptr + 256);
+    printf("Chunk tails were reused.\n");
+
+    clock_t end = clock();
+    printf("Time taken for test_chunk_tail: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+int main() {
+    test_pmr();
+    test_chunk_tail();
+    printf("All pmr checks passed.\n");
+    return 0;
+}
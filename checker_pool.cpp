@@ -0,0 +1,98 @@
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "mmu_object_pool.hpp"
+
+// Checks of the object pool front end: ObjectPool with and without a ThreadCache.
+//
+// Build: gcc -O2 -c mmu_impl.c && g++ -std=c++17 -O2 checker_pool.cpp mmu_impl.o -o checker_pool -lpthread
+
+// Timer function to calculate elapsed time
+double calculate_time_taken(clock_t start, clock_t end) {
+    return ((double)(end - start)) / CLOCKS_PER_SEC;
+}
+
+struct Node {
+    unsigned page;
+    Node* next;
+    Node(unsigned p) : page(p), next(nullptr) {}
+};
+
+struct alignas(64) Wide {
+    char bytes[100];
+};
+
+struct Thrower {
+    Thrower(bool fail) {
+        if (fail) throw std::runtime_error("constructor failed");
+    }
+};
+
+// Freed slots are reused first, over-aligned types stay aligned, and a throwing constructor gives its slot back
+void test_object_pool() {
+    printf("Testing ObjectPool...\n");
+    clock_t start = clock();
+
+    mmu::ObjectPool<Node> pool;
+    std::vector<Node*> nodes;
+    for (unsigned i = 0; i < 10000; i++) nodes.push_back(pool.construct(i));
+    for (unsigned i = 0; i < 10000; i++) assert(nodes[i]->page == i);
+    Node* freed = nodes[1234];
+    pool.destroy(freed);
+    assert(pool.construct(7u) == freed);
+
+    mmu::ObjectPool<Wide> wide;
+    for (int i = 0; i < 1000; i++) assert(reinterpret_cast<uintptr_t>(wide.allocate()) % alignof(Wide) == 0);
+
+    mmu::ObjectPool<Thrower> throwing;
+    Thrower* ok = throwing.construct(false);
+    throwing.destroy(ok);
+    bool thrown = false;
+    try {
+        throwing.construct(true);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown && throwing.allocate() == ok);
+    printf("ObjectPool reused freed slots.\n");
+
+    clock_t end = clock();
+    printf("Time taken for test_object_pool: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+// Threads taking and returning slots of one shared pool through their own ThreadCache
+void test_thread_cache() {
+    printf("Testing ObjectPool with ThreadCache...\n");
+    clock_t start = clock();
+
+    mmu::ObjectPool<Node, true> shared;
+    auto work = [&shared](unsigned id) {
+        mmu::ObjectPool<Node, true>::ThreadCache cache(shared);
+        std::vector<Node*> mine(500);
+        for (int round = 0; round < 200; round++) {
+            for (unsigned i = 0; i < 500; i++) mine[i] = cache.construct(id * 1000 + i);
+            for (unsigned i = 0; i < 500; i++) {
+                assert(mine[i]->page == id * 1000 + i); // No slot was handed to two threads
+                cache.destroy(mine[i]);
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned id = 0; id < 4; id++) threads.emplace_back(work, id);
+    for (std::thread& thread : threads) thread.join();
+    printf("Threads shared the pool without overlapping slots.\n");
+
+    clock_t end = clock();
+    printf("Time taken for test_thread_cache: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+int main() {
+    test_object_pool();
+    test_thread_cache();
+    printf("All pool checks passed.\n");
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <time.h>
+#include "my_mmu.h"
+
+// Checks of the sampling heap profiler. Build it with -DMALLOC_ALIGNMENT=16 as well: sampled blocks
+// must be taken and keep the alignment my_malloc has there too.
+//
+// Build: gcc -O2 checker_profile.c -o checker_profile -lpthread
+//        gcc -O2 -DMALLOC_ALIGNMENT=16 checker_profile.c -o checker_profile16 -lpthread
+
+// Timer function to calculate elapsed time
+double calculate_time_taken(clock_t start, clock_t end) {
+    return ((double)(end - start)) / CLOCKS_PER_SEC;
+}
+
+// Estimated number of live objects in the header line of a heap profile dump
+static double dumped_objects() {
+    FILE* out = tmpfile();
+    assert(out);
+    my_malloc_profile_dump(out);
+    rewind(out);
+    double objects = -1;
+    unsigned long rate = 0;
+    assert(fscanf(out, "heap profile: %lf: %*f [%*f: %*f] @ heap_v2/%lu", &objects, &rate) == 2);
+    fclose(out);
+    return objects;
+}
+
+// Live allocations are sampled from my_malloc, my_calloc and my_realloc, and their samples go away when freed
+void test_profile() {
+    printf("Testing the heap profiler...\n");
+    clock_t start = clock();
+
+    assert(my_malloc_profile_start(64 * 1024) == 0);
+    void* ptrs[20000];
+    for (int i = 0; i < 20000; i++) {
+        ptrs[i] = i % 3 ? my_malloc(100 + i % 3000) : my_calloc(1, 100 + i % 900);
+        if (i % 5 == 0) ptrs[i] = my_realloc(ptrs[i], 200 + i % 5000);
+        assert(ptrs[i] && (uintptr_t)ptrs[i] % MALLOC_ALIGNMENT == 0);
+        memset(ptrs[i], 0x3c, 100);
+    }
+    double objects = dumped_objects();
+    printf("Profile estimates %.0f live objects.\n", objects);
+    assert(objects > 0);
+    for (int i = 0; i < 20000; i++) my_free(ptrs[i]);
+    my_malloc_profile_stop();
+    assert(dumped_objects() == 0);
+    printf("Freed allocations left the profile.\n");
+
+    clock_t end = clock();
+    printf("Time taken for test_profile: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+int main() {
+    test_profile();
+    printf("All profiler checks passed.\n");
+    return 0;
+}
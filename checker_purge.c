@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "my_mmu.h"
+
+// Checks that free memory goes back to the kernel: large free blocks and empty slabs once they have
+// been unused for PURGE_DECAY_MS, and slab regions as soon as my_malloc_trim is called.
+//
+// Build: gcc -O2 checker_purge.c -o checker_purge -lpthread
+
+// Timer function to calculate elapsed time
+double calculate_time_taken(clock_t start, clock_t end) {
+    return ((double)(end - start)) / CLOCKS_PER_SEC;
+}
+
+// Resident set size of the process in bytes
+static size_t resident_bytes() {
+    FILE* statm = fopen("/proc/self/statm", "r");
+    assert(statm);
+    unsigned long pages = 0, resident = 0;
+    assert(fscanf(statm, "%lu %lu", &pages, &resident) == 2);
+    fclose(statm);
+    return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+// Freed memory stays resident until the decay delay passes, then the next arena operation purges it
+void test_decay_purge() {
+    printf("Testing purging after the decay delay...\n");
+    clock_t start = clock();
+
+    static void* ptrs[4000];
+    for (int i = 0; i < 4000; i++) {
+        ptrs[i] = my_malloc(i % 2 ? 100 * 1024 : 64); // Large arena blocks and slab objects
+        assert(ptrs[i]);
+        memset(ptrs[i], 0x5a, i % 2 ? 100 * 1024 : 64);
+    }
+    for (int i = 0; i < 4000; i++) my_free(ptrs[i]);
+    size_t madvise_calls = my_mallinfo().madvise_calls;
+    size_t resident = resident_bytes();
+
+    usleep((PURGE_DECAY_MS + 200) * 1000);
+    my_free(my_malloc(4096)); // Too large for the thread cache, so it locks the arena
+    my_mallinfo_t info = my_mallinfo();
+    size_t purged = resident - resident_bytes();
+    printf("%zu madvise calls purged %zu KB.\n", info.madvise_calls - madvise_calls, purged / 1024);
+    assert(info.madvise_calls > madvise_calls);
+    assert(purged > 100u * 1024 * 1024);
+
+    clock_t end = clock();
+    printf("Time taken for test_decay_purge: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+// Slab regions left without live objects are unmapped by my_malloc_trim
+void test_trim_slabs() {
+    printf("Testing trimming of slab regions...\n");
+    clock_t start = clock();
+
+    size_t count = 64u * 1024 * 1024 / 64;
+    void** ptrs = (void**)malloc(count * sizeof(void*));
+    assert(ptrs);
+    size_t mapped = my_mallinfo().mapped;
+    for (size_t i = 0; i < count; i++) {
+        ptrs[i] = my_malloc(64);
+        assert(ptrs[i]);
+    }
+    size_t grown = my_mallinfo().mapped - mapped;
+    for (size_t i = 0; i < count; i++) my_free(ptrs[i]);
+    my_malloc_trim();
+    size_t trimmed = my_mallinfo().mapped;
+    printf("Slabs mapped %zu KB; %zu KB mapped before them, %zu KB after trimming.\n", grown / 1024,
+           mapped / 1024, trimmed / 1024);
+    assert(trimmed < mapped + grown / 8);
+    free(ptrs);
+
+    clock_t end = clock();
+    printf("Time taken for test_trim_slabs: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+int main() {
+    test_decay_purge();
+    test_trim_slabs();
+    printf("All purge checks passed.\n");
+    return 0;
+}
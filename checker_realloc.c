@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <time.h>
+#include "my_mmu.h"
+
+// Checks of my_realloc: growth into a free neighbour, shrinking in place, and large blocks moved with
+// mremap instead of copied.
+//
+// Build: gcc -O2 checker_realloc.c -o checker_realloc -lpthread
+
+// Timer function to calculate elapsed time
+double calculate_time_taken(clock_t start, clock_t end) {
+    return ((double)(end - start)) / CLOCKS_PER_SEC;
+}
+
+// Whether size bytes at ptr all hold value
+static int filled_with(const void* ptr, size_t size, unsigned char value) {
+    const unsigned char* bytes = (const unsigned char*)ptr;
+    for (size_t i = 0; i < size; i++) {
+        if (bytes[i] != value) return 0;
+    }
+    return 1;
+}
+
+// Growing into a free neighbour keeps the pointer; large blocks are moved by the kernel with mremap
+void test_realloc_in_place() {
+    printf("Testing my_realloc in place and with mremap...\n");
+    clock_t start = clock();
+
+    char* ptr = (char*)my_malloc(1000);
+    char* next = (char*)my_malloc(4000);
+    char* guard = (char*)my_malloc(1000);
+    assert(ptr && next && guard);
+    memset(ptr, 0x11, 1000);
+    my_free(next);
+    char* grown = (char*)my_realloc(ptr, 3000);
+    assert(grown == ptr); // The freed neighbour was absorbed
+    assert(filled_with(grown, 1000, 0x11));
+    my_free(grown);
+    my_free(guard);
+
+    size_t size = 1024 * 1024;
+    char* large = (char*)my_malloc(size);
+    assert(large);
+    memset(large, 0x22, size);
+    size_t remaps = my_mallinfo().mremap_calls;
+    for (int i = 0; i < 5; i++) {
+        size *= 2;
+        large = (char*)my_realloc(large, size);
+        assert(large && filled_with(large, 1024 * 1024, 0x22));
+    }
+    assert(my_mallinfo().mremap_calls > remaps);
+    large = (char*)my_realloc(large, 1024 * 1024); // And shrunk again
+    assert(large && filled_with(large, 1024 * 1024, 0x22));
+    my_free(large);
+    printf("Blocks grew in place and large blocks were remapped.\n");
+
+    clock_t end = clock();
+    printf("Time taken for test_realloc_in_place: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+// Shrinking keeps the pointer, and the tail given back is reused by the next allocation that fits
+void test_realloc_shrink() {
+    printf("Testing my_realloc shrinking in place...\n");
+    clock_t start = clock();
+
+    char* ptr = (char*)my_malloc(8000);
+    char* guard = (char*)my_malloc(1000);
+    assert(ptr && guard);
+    memset(ptr, 0x44, 8000);
+    char* shrunk = (char*)my_realloc(ptr, 2000);
+    assert(shrunk == ptr && filled_with(shrunk, 2000, 0x44));
+    char* tail = (char*)my_malloc(4000);
+    assert(tail > ptr && tail < guard); // Carved from the tail the shrink gave back
+    my_free(tail);
+    my_free(shrunk);
+    my_free(guard);
+    printf("Shrunk blocks stayed in place and gave their tail back.\n");
+
+    clock_t end = clock();
+    printf("Time taken for test_realloc_shrink: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+int main() {
+    test_realloc_in_place();
+    test_realloc_shrink();
+    printf("All realloc checks passed.\n");
+    return 0;
+}
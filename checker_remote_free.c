@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "my_mmu.h"
+
+// Checks of frees made by a thread other than the one that allocated the memory: the object goes back
+// to its owner's arena through the remote-free list, once, however often it is freed.
+//
+// Build: gcc -O2 checker_remote_free.c -o checker_remote_free -lpthread
+
+// Timer function to calculate elapsed time
+double calculate_time_taken(clock_t start, clock_t end) {
+    return ((double)(end - start)) / CLOCKS_PER_SEC;
+}
+
+static void* free_on_other_thread(void* ptr) {
+    my_free(ptr);
+    return NULL;
+}
+
+static void* free_twice_on_other_thread(void* ptr) {
+    my_free(ptr);
+    my_free(ptr);
+    return NULL;
+}
+
+// A block freed by another thread goes back to the arena of the thread that allocated it
+void test_remote_free() {
+    printf("Testing frees from another thread...\n");
+    clock_t start = clock();
+
+    int reused = 0;
+    for (int round = 0; round < 100; round++) {
+        void* keep = my_malloc(2048); // Keeps the freed block from merging into the top
+        void* ptr = my_malloc(2048);
+        pthread_t thread;
+        assert(pthread_create(&thread, NULL, free_on_other_thread, ptr) == 0);
+        pthread_join(thread, NULL);
+
+        void* again = my_malloc(2048);
+        assert(again);
+        if (again == ptr) reused++;
+        my_free(again);
+        my_free(keep);
+    }
+    if (reused == 100) {
+        printf("Blocks freed on another thread were reused by their owner.\n");
+    } else {
+        printf("Blocks freed on another thread were not reused (%d of 100)!\n", reused);
+    }
+    assert(reused == 100);
+
+    clock_t end = clock();
+    printf("Time taken for test_remote_free: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+// A repeated remote free is ignored: the block is handed out once, not to two callers
+void test_remote_double_free() {
+    printf("Testing repeated frees from another thread...\n");
+    clock_t start = clock();
+
+    size_t sizes[] = { 64, 2048, 100000 };
+    for (int s = 0; s < 3; s++) {
+        void* keep = my_malloc(sizes[s]);
+        void* ptr = my_malloc(sizes[s]);
+        pthread_t thread;
+        assert(pthread_create(&thread, NULL, free_twice_on_other_thread, ptr) == 0);
+        pthread_join(thread, NULL);
+
+        void* first = my_malloc(sizes[s]);
+        void* second = my_malloc(sizes[s]);
+        assert(first && second && first != second);
+        memset(first, 1, sizes[s]);
+        memset(second, 2, sizes[s]);
+        my_free(first);
+        my_free(second);
+        my_free(keep);
+    }
+    printf("Repeated frees from another thread were ignored.\n");
+
+    clock_t end = clock();
+    printf("Time taken for test_remote_double_free: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+int main() {
+    test_remote_free();
+    test_remote_double_free();
+    printf("All remote free checks passed.\n");
+    return 0;
+}
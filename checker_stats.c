@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <time.h>
+#include "my_mmu.h"
+
+// Checks of my_mallinfo and my_malloc_stats_json: bytes in use and their peak, mapped bytes and
+// system call counts.
+//
+// Build: gcc -O2 checker_stats.c -o checker_stats -lpthread
+
+// Timer function to calculate elapsed time
+double calculate_time_taken(clock_t start, clock_t end) {
+    return ((double)(end - start)) / CLOCKS_PER_SEC;
+}
+
+// in_use follows allocations and frees, and peak_in_use keeps the highest value it reached
+void test_mallinfo() {
+    printf("Testing my_mallinfo...\n");
+    clock_t start = clock();
+
+    my_mallinfo_t before = my_mallinfo();
+    void* small[1000];
+    void* large[4];
+    for (int i = 0; i < 1000; i++) small[i] = my_malloc(1000);
+    for (int i = 0; i < 4; i++) large[i] = my_malloc(1024 * 1024);
+    size_t handed_out = 1000 * 1000 + 4 * 1024 * 1024;
+
+    my_mallinfo_t during = my_mallinfo();
+    assert(during.in_use >= before.in_use + handed_out);
+    assert(during.peak_in_use >= during.in_use);
+    assert(during.mapped >= handed_out && during.peak_mapped >= during.mapped);
+    assert(during.mmap_calls >= before.mmap_calls + 4); // One mapping per large block
+
+    for (int i = 0; i < 1000; i++) my_free(small[i]);
+    for (int i = 0; i < 4; i++) my_free(large[i]);
+    my_mallinfo_t after = my_mallinfo();
+    printf("In use: %zu KB with the blocks, %zu KB after freeing, peak %zu KB.\n", during.in_use / 1024,
+           after.in_use / 1024, after.peak_in_use / 1024);
+    assert(after.in_use + 4 * 1024 * 1024 <= during.in_use);
+    assert(after.peak_in_use >= during.in_use);
+    assert(after.munmap_calls >= during.munmap_calls + 4);
+
+    FILE* out = tmpfile();
+    assert(out);
+    my_malloc_stats_json(out);
+    rewind(out);
+    char json[256];
+    assert(fgets(json, sizeof(json), out) && strstr(json, "\"peak_in_use\":"));
+    fclose(out);
+    printf("Statistics followed the heap.\n");
+
+    clock_t end = clock();
+    printf("Time taken for test_mallinfo: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+int main() {
+    test_mallinfo();
+    printf("All statistics checks passed.\n");
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "my_mmu.h"
+
+// Checks of allocation tracing: a known sequence of calls is recorded, read back record by record,
+// and replayed by trace_replay, which must replay every call.
+//
+// Build: gcc -O2 trace_replay.c -o trace_replay -lpthread
+//        gcc -O2 checker_trace.c -o checker_trace -lpthread
+// Usage: ./checker_trace   (with trace_replay in the current directory)
+
+#define TRACE_PATH "checker_trace.trace"
+
+// Timer function to calculate elapsed time
+double calculate_time_taken(clock_t start, clock_t end) {
+    return ((double)(end - start)) / CLOCKS_PER_SEC;
+}
+
+// Record 1000 mallocs, 200 callocs, 50 memaligns, 100 reallocs and a free of everything
+static void record_calls() {
+    static void* ptrs[1250];
+    assert(my_malloc_trace_start(TRACE_PATH) == 0);
+    for (int i = 0; i < 1000; i++) ptrs[i] = my_malloc(16 + i * 7);
+    for (int i = 1000; i < 1200; i++) ptrs[i] = my_calloc(4, 100);
+    for (int i = 1200; i < 1250; i++) ptrs[i] = my_memalign(256, 1000);
+    for (int i = 0; i < 100; i++) ptrs[i * 10] = my_realloc(ptrs[i * 10], 5000);
+    for (int i = 0; i < 1250; i++) my_free(ptrs[i]);
+    my_malloc_trace_stop();
+}
+
+// The trace file holds one record per call, of the kind made
+void test_trace_records() {
+    printf("Testing trace recording...\n");
+    clock_t start = clock();
+
+    record_calls();
+    FILE* in = fopen(TRACE_PATH, "rb");
+    assert(in);
+    trace_header_t header;
+    assert(fread(&header, sizeof(header), 1, in) == 1);
+    assert(memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) == 0 && header.version == TRACE_VERSION);
+    size_t counts[TRACE_MEMALIGN + 1] = { 0 };
+    size_t total = 0;
+    trace_record_t record;
+    while (fread(&record, sizeof(record), 1, in) == 1) {
+        assert(record.op <= TRACE_MEMALIGN);
+        counts[record.op]++;
+        total++;
+    }
+    fclose(in);
+    assert(counts[TRACE_MALLOC] == 1000 && counts[TRACE_CALLOC] == 200 && counts[TRACE_MEMALIGN] == 50);
+    assert(counts[TRACE_REALLOC] == 100 && counts[TRACE_FREE] == 1250 && total == 2600);
+    printf("All %zu calls were recorded.\n", total);
+
+    clock_t end = clock();
+    printf("Time taken for test_trace_records: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+// trace_replay turns every recorded call into one replayed call, for my_malloc and the system malloc
+void test_trace_replay() {
+    printf("Testing trace replay...\n");
+    clock_t start = clock();
+
+    FILE* out = popen("./trace_replay " TRACE_PATH, "r");
+    assert(out);
+    char line[256];
+    size_t records = 0, calls = 0, replays = 0;
+    assert(fgets(line, sizeof(line), out) && sscanf(line, "%zu records, %zu calls replayed", &records, &calls) == 2);
+    while (fgets(line, sizeof(line), out)) {
+        char name[32];
+        size_t replayed;
+        if (sscanf(line, "%31s %zu", name, &replayed) == 2 && replayed == calls) replays++;
+    }
+    assert(pclose(out) == 0);
+    printf("%zu records gave %zu replayed calls, on %zu allocators.\n", records, calls, replays);
+    assert(records == 2600 && calls == 2600 && replays == 2);
+    unlink(TRACE_PATH);
+
+    clock_t end = clock();
+    printf("Time taken for test_trace_replay: %.6f seconds\n", calculate_time_taken(start, end));
+}
+
+int main() {
+    test_trace_records();
+    test_trace_replay();
+    printf("All trace checks passed.\n");
+    return 0;
+}
@@ -0,0 +1,88 @@
+// Live heap monitor for processes using 2021MT10924mmu.h with a stats page enabled
+// (MY_MALLOC_STATS_SHM=<name> in the environment, or my_malloc_stats_shm("<name>")).
+// Every interval it prints the call rates, live and mapped bytes, and how full each slab class is.
+//
+// Build: gcc -O2 heapmon.c -o heapmon
+// Usage: ./heapmon <name> [interval_ms]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mmu_shm_stats.h"
+
+// Wall-clock time in seconds
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t load(uint64_t *counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <name> [interval_ms]\n", argv[0]);
+        return 1;
+    }
+    int interval_ms = argc > 2 ? atoi(argv[2]) : 1000;
+    if (interval_ms < 1) interval_ms = 1;
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s%s", argv[1][0] == '/' ? "" : "/dev/shm/", argv[1]);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(shm_stats_t)) {
+        fprintf(stderr, "%s: not a stats page\n", path);
+        return 1;
+    }
+    shm_stats_t *page = (shm_stats_t *)mmap(NULL, sizeof(shm_stats_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED || __atomic_load_n(&page->magic, __ATOMIC_ACQUIRE) != STATS_SHM_MAGIC ||
+        page->version != STATS_SHM_VERSION) {
+        fprintf(stderr, "%s: not a stats page of this allocator version\n", path);
+        return 1;
+    }
+
+    printf("pid %d, %u arenas\n", page->pid, page->arenas);
+    uint64_t last_allocs = load(&page->allocations), last_frees = load(&page->frees);
+    double last = now_seconds();
+    struct timespec pause = { interval_ms / 1000, (interval_ms % 1000) * 1000000L };
+    for (;;) {
+        nanosleep(&pause, NULL);
+        double now = now_seconds();
+        uint64_t allocs = load(&page->allocations), frees = load(&page->frees);
+        uint64_t live = load(&page->direct_live);
+        for (uint32_t i = 0; i < page->arenas && i < STATS_SHM_MAX_ARENAS; i++) {
+            live += load(&page->arena_live[i]);
+        }
+
+        printf("allocs/s %10.0f  frees/s %10.0f  live %8.2f MiB  mapped %8.2f MiB  peak %8.2f MiB\n",
+               (allocs - last_allocs) / (now - last), (frees - last_frees) / (now - last),
+               live / 1048576.0, load(&page->mapped) / 1048576.0, load(&page->peak_mapped) / 1048576.0);
+
+        // Occupancy of every slab class that has slabs, as objects in use / objects that fit
+        printf("  slabs:");
+        for (size_t cls = 0; cls < STATS_SHM_SLAB_CLASSES; cls++) {
+            uint64_t capacity = load(&page->slab_capacity[cls]);
+            if (!capacity) continue;
+            printf(" %zu:%.0f%%", (cls + 1) * STATS_SHM_SLAB_ALIGN, 100.0 * load(&page->slab_objects[cls]) / capacity);
+        }
+        printf("\n");
+        fflush(stdout);
+
+        last_allocs = allocs;
+        last_frees = frees;
+        last = now;
+    }
+}
@@ -0,0 +1,87 @@
+// Shared-library build of 2021MT10924mmu.h that replaces the C allocator of unmodified programs:
+//
+//   LD_PRELOAD=./libmymalloc.so <program>
+//
+// Every entry point is served by the allocator itself, so no dlsym lookup of the system malloc is needed
+// and calls made while the dynamic loader or libc are still starting up (such as the early calloc of
+// dlsym-based shims) need no bootstrap buffer. Pointers the allocator never handed out (allocated by the
+// loader before this library took over) are left alone by free and realloc instead of being misread.
+// The thread-local caches use the initial-exec TLS model, so reaching them never calls back into malloc.
+// Every pointer handed out sits at a multiple of 16, as the ABI promises (SSE code relies on it), and
+// failed allocations set errno to ENOMEM.
+//
+// Build: gcc -O2 -fPIC -shared -ftls-model=initial-exec malloc_shim.c -o libmymalloc.so -lpthread
+// Usage: LD_PRELOAD=./libmymalloc.so <program> [args...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#define MALLOC_ALIGNMENT 16
+#include "2021MT10924mmu.h"
+
+// Whether ptr lies in memory this allocator owns: an arena or slab region, or a dedicated mapping,
+// whose header is flagged as such and whose payload runs to the end of a page
+static int owned(void *ptr) {
+    if (region_owner(ptr)) return 1;
+    block_t *block = ptr_to_block(ptr);
+    return has_flag(block, BLOCK_MMAPPED) && !(((uintptr_t)ptr + block_size(block)) & (SLAB_PAGE_SIZE - 1));
+}
+
+// A zero-byte request still returns a unique pointer, as programs written against glibc expect
+void *malloc(size_t size) {
+    void *ptr = my_malloc(size ? size : 1);
+    if (!ptr) errno = ENOMEM;
+    return ptr;
+}
+
+void free(void *ptr) {
+    if (ptr && owned(ptr)) my_free(ptr);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    void *ptr = nmemb && size ? my_calloc(nmemb, size) : my_malloc(1);
+    if (!ptr) errno = ENOMEM;
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (ptr && !owned(ptr)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    void *moved = my_realloc(ptr, size);
+    if (!moved && size) errno = ENOMEM; // A zero size frees the block and returns NULL
+    return moved;
+}
+
+// glibc rounds an alignment that is not a power of two up to the next one
+void *memalign(size_t alignment, size_t size) {
+    size_t power = MALLOC_ALIGNMENT;
+    while (power && power < alignment) power <<= 1;
+    if (!power) {
+        errno = EINVAL;
+        return NULL;
+    }
+    void *ptr = my_memalign(power, size ? size : 1);
+    if (!ptr) errno = ENOMEM;
+    return ptr;
+}
+
+// Alignments below MALLOC_ALIGNMENT are raised to it once validated, as in memalign
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1))) return EINVAL;
+    return my_posix_memalign(memptr, alignment < MALLOC_ALIGNMENT ? MALLOC_ALIGNMENT : alignment, size ? size : 1);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    if (!alignment || (alignment & (alignment - 1))) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return memalign(alignment, size);
+}
+
+size_t malloc_usable_size(void *ptr) {
+    if (!ptr || !owned(ptr)) return 0;
+    return my_malloc_usable_size(ptr);
+}
@@ -5,11 +5,13 @@
 #include <string.h>
 #include <errno.h>
 #include <stdint.h>
+#include <pthread.h>
 
 #define MMAP_THRESHOLD (128 * 1024)  // mmap for large allocations (> 128KB)
-#define MIN_ALLOC_SIZE 16  // Minimum block size to reduce fragmentation
+#define MIN_ALLOC_SIZE 16  // Minimum block size to reduce fragmentation; also room for a free block's tree links
 #define ALIGNMENT 16  // Ensure 16-byte alignment for all allocations
-#define MAX_ITERATIONS 1000000  // Maximum iterations for find_best_fit_block
+#define TRIM_THRESHOLD (256 * 1024)  // Shrink the heap once the free block at its end is this large
+#define TRIM_PAD (128 * 1024)  // Free space kept at the end of the heap after trimming, so regrowth is not immediate
 
 typedef struct block_meta {
     size_t size;
@@ -19,31 +21,103 @@ typedef struct block_meta {
     int mmaped;
 } block_meta;
 
+// Free blocks are indexed in a treap ordered by (size, address), so best-fit is a single descent.
+// The links live in the free block's payload; node priorities are a hash of the block's address.
+typedef struct tree_links {
+    block_meta* left;
+    block_meta* right;
+} tree_links;
+
 block_meta* global_base = NULL;
+static block_meta* global_tail = NULL;  // Last sbrk block, so extending the heap needs no list walk
+static block_meta* free_root = NULL;  // Root of the free-block treap
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;  // Serialises every access to the block list and sbrk
 
 static size_t align(size_t size) {
     return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
 }
 
-// Find the best-fit free block
+static tree_links* links(block_meta* block) {
+    return (tree_links*)(block + 1);
+}
+
+// Treap priority of a block, derived from its address
+static uintptr_t priority(block_meta* block) {
+    return ((uintptr_t)block * 0x9E3779B97F4A7C15ULL) >> 7;
+}
+
+// Tree order: by size, then by address so equal sizes are distinct keys
+static int tree_less(block_meta* a, block_meta* b) {
+    return a->size < b->size || (a->size == b->size && a < b);
+}
+
+// Split the subtree at *root into blocks ordered before key (*lo) and after it (*hi)
+static void tree_split(block_meta* root, block_meta* key, block_meta** lo, block_meta** hi) {
+    while (root) {
+        if (tree_less(root, key)) {
+            *lo = root;
+            lo = &links(root)->right;
+            root = links(root)->right;
+        } else {
+            *hi = root;
+            hi = &links(root)->left;
+            root = links(root)->left;
+        }
+    }
+    *lo = NULL;
+    *hi = NULL;
+}
+
+// Add a free block to the index
+static void tree_insert(block_meta* block) {
+    block_meta** link = &free_root;
+    while (*link && priority(*link) > priority(block)) {
+        link = tree_less(block, *link) ? &links(*link)->left : &links(*link)->right;
+    }
+    tree_split(*link, block, &links(block)->left, &links(block)->right);
+    *link = block;
+}
+
+// Remove a free block from the index
+static void tree_remove(block_meta* block) {
+    block_meta** link = &free_root;
+    while (*link != block) {
+        link = tree_less(block, *link) ? &links(*link)->left : &links(*link)->right;
+    }
+    // Replace the block by the merge of its two subtrees
+    block_meta* left = links(block)->left;
+    block_meta* right = links(block)->right;
+    while (left && right) {
+        if (priority(left) > priority(right)) {
+            *link = left;
+            link = &links(left)->right;
+            left = links(left)->right;
+        } else {
+            *link = right;
+            link = &links(right)->left;
+            right = links(right)->left;
+        }
+    }
+    *link = left ? left : right;
+}
+
+// Find the best-fit free block: the smallest one of at least size bytes
 static block_meta* find_best_fit_block(size_t size) {
     block_meta* best_fit = NULL;
-    block_meta* current = global_base;
-    int iterations = 0;
-    while (current && iterations < MAX_ITERATIONS) {
-        if (current->free && current->size >= size) {
-            if (!best_fit || current->size < best_fit->size) {
-                best_fit = current;
-            }
+    block_meta* current = free_root;
+    while (current) {
+        if (current->size >= size) {
+            best_fit = current;
+            current = links(current)->left;
+        } else {
+            current = links(current)->right;
         }
-        current = current->next;
-        iterations++;
     }
     return best_fit;
 }
 
-// Request space from OS using sbrk for small blocks
-static block_meta* request_space(block_meta* last, size_t size) {
+// Request space from OS using sbrk for small blocks and append it to the block list
+static block_meta* request_space(size_t size) {
     block_meta* block = sbrk(0);
     void* request = sbrk(size + sizeof(block_meta));
     if (request == (void*) -1) {
@@ -52,13 +126,16 @@ static block_meta* request_space(block_meta* last, size_t size) {
 
     block->size = size;
     block->next = NULL;
-    block->prev = last;
+    block->prev = global_tail;
     block->free = 0;
     block->mmaped = 0;
 
-    if (last) {
-        last->next = block;
+    if (global_tail) {
+        global_tail->next = block;
+    } else {
+        global_base = block;
     }
+    global_tail = block;
     return block;
 }
 
@@ -76,6 +153,38 @@ static block_meta* request_space_mmap(size_t size) {
     return block;
 }
 
+// Start of a mapped block's mapping: the block itself, unless an aligned payload put it further in
+static char* mapping_start(block_meta* block) {
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    return (char*)((uintptr_t)block & ~(page_size - 1));
+}
+
+// Map a block whose payload is a multiple of alignment, giving back the unused pages at either end
+static block_meta* request_aligned_mmap(size_t alignment, size_t size) {
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t reserve = (alignment + size + page_size - 1) & ~(page_size - 1);
+    char* mem = mmap(0, reserve, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        return NULL; // mmap failed
+    }
+    char* payload = (char*)(((uintptr_t)mem + sizeof(block_meta) + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    block_meta* block = (block_meta*)payload - 1;
+    char* start = mapping_start(block);
+    char* end = (char*)(((uintptr_t)payload + size + page_size - 1) & ~(page_size - 1));
+    if (start > mem) {
+        munmap(mem, start - mem);
+    }
+    if (end < mem + reserve) {
+        munmap(end, mem + reserve - end);
+    }
+    block->size = end - payload;
+    block->next = NULL;
+    block->prev = NULL;
+    block->free = 0;
+    block->mmaped = 1;
+    return block;
+}
+
 // Split the block if there's excess space after allocation
 static void split_block(block_meta* block, size_t size) {
     if (block->size >= size + sizeof(block_meta) + MIN_ALLOC_SIZE) {
@@ -89,8 +198,11 @@ static void split_block(block_meta* block, size_t size) {
 
         if (block->next) {
             block->next->prev = new_block;
+        } else {
+            global_tail = new_block;
         }
         block->next = new_block;
+        tree_insert(new_block);
     }
 }
 
@@ -109,57 +221,79 @@ void* my_malloc(size_t size) {
     block_meta* block;
 
     if (aligned_size + sizeof(block_meta) >= MMAP_THRESHOLD) {
+        // Mapped blocks stay out of the block list, so they need no lock
         block = request_space_mmap(aligned_size);
         if (!block) {
             errno = ENOMEM;
             return NULL;
         }
-    } else {
-        block = find_best_fit_block(aligned_size);
-        if (!block) {
-            block_meta* last = global_base;
-            if (last) {
-                while (last->next) {
-                    last = last->next;
-                }
-            }
-            block = request_space(last, aligned_size);
-            if (!block) {
-                errno = ENOMEM;
-                return NULL;
-            }
-        } else {
-            block->free = 0;
-            split_block(block, aligned_size);
-        }
+        return (void*)(block + 1);
     }
 
-    if (!global_base) {
-        global_base = block;
+    pthread_mutex_lock(&heap_lock);
+    block = find_best_fit_block(aligned_size);
+    if (!block) {
+        block = request_space(aligned_size);
+        if (!block) {
+            pthread_mutex_unlock(&heap_lock);
+            errno = ENOMEM;
+            return NULL;
+        }
+    } else {
+        tree_remove(block);
+        block->free = 0;
+        split_block(block, aligned_size);
     }
+    pthread_mutex_unlock(&heap_lock);
 
     return (void*)(block + 1);
 }
 
-// Coalesce adjacent free blocks
+// Coalesce adjacent free blocks and index the result
 static void coalesce(block_meta* block) {
-    // Coalesce with the next block if it's free and not mmaped
-    if (block->next && block->next->free && !block->mmaped && !block->next->mmaped) {
+    // Coalesce with the next block if it's free
+    if (block->next && block->next->free) {
+        tree_remove(block->next);
         block->size += block->next->size + sizeof(block_meta);
         block->next = block->next->next;
         if (block->next) {
             block->next->prev = block;
+        } else {
+            global_tail = block;
         }
     }
-    // Coalesce with the previous block if it's free and not mmaped
-    if (block->prev && block->prev->free && !block->mmaped && !block->prev->mmaped) {
+    // Coalesce with the previous block if it's free
+    if (block->prev && block->prev->free) {
+        tree_remove(block->prev);
         block->prev->size += block->size + sizeof(block_meta);
         block->prev->next = block->next;
         if (block->next) {
             block->next->prev = block->prev;
+        } else {
+            global_tail = block->prev;
         }
         block = block->prev;
     }
+    tree_insert(block);
+}
+
+// Give the end of the heap back to the OS if a large free block sits there and nothing else moved the break
+static void trim_heap(void) {
+    block_meta* tail = global_tail;
+    if (!tail || !tail->free || tail->size < TRIM_THRESHOLD) {
+        return;
+    }
+    if (sbrk(0) != (void*)((char*)(tail + 1) + tail->size)) {
+        return;  // Someone else's memory lies above the heap
+    }
+
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t release = (tail->size - TRIM_PAD) & ~(page_size - 1);
+    tree_remove(tail);
+    if (sbrk(-(intptr_t)release) != (void*)-1) {
+        tail->size -= release;
+    }
+    tree_insert(tail);
 }
 
 void my_free(void* ptr) {
@@ -170,10 +304,16 @@ void my_free(void* ptr) {
     block_meta* block_ptr = (block_meta*)ptr - 1;
 
     if (block_ptr->mmaped) {
-        munmap(block_ptr, block_ptr->size + sizeof(block_meta));
+        char* start = mapping_start(block_ptr);
+        munmap(start, (char*)ptr + block_ptr->size - start);
     } else {
-        block_ptr->free = 1;
-        coalesce(block_ptr);
+        pthread_mutex_lock(&heap_lock);
+        if (!block_ptr->free) {  // A double free must not index the block twice
+            block_ptr->free = 1;
+            coalesce(block_ptr);
+            trim_heap();
+        }
+        pthread_mutex_unlock(&heap_lock);
     }
 }
 
@@ -184,8 +324,87 @@ void* my_calloc(size_t nmemb, size_t size) {
         return NULL;
     }
     void* ptr = my_malloc(total_size);
-    if (ptr) {
+    if (ptr && !((block_meta*)ptr - 1)->mmaped) {  // A fresh mapping is already zero; clearing it would fault in every page
         memset(ptr, 0, total_size);
     }
     return ptr;
+}
+
+// Allocate size bytes at a multiple of alignment, which must be a power of two; freed with my_free.
+// A larger block is taken and the padding before the aligned payload is split off as a free block.
+void* my_memalign(size_t alignment, size_t size) {
+    if (size == 0 || !alignment || (alignment & (alignment - 1))) return NULL;
+    if (alignment <= ALIGNMENT) return my_malloc(size);
+
+    size_t aligned_size = align(size);
+    if (aligned_size < MIN_ALLOC_SIZE) aligned_size = MIN_ALLOC_SIZE;
+    // Worst case: the padding must itself be big enough to stand as a free block
+    size_t padded = aligned_size + alignment + sizeof(block_meta) + MIN_ALLOC_SIZE;
+    if (aligned_size < size || padded < aligned_size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    block_meta* block;
+    if (padded + sizeof(block_meta) >= MMAP_THRESHOLD) {
+        block = request_aligned_mmap(alignment, aligned_size);
+        if (!block) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        return (void*)(block + 1);
+    }
+
+    pthread_mutex_lock(&heap_lock);
+    block = find_best_fit_block(padded);
+    if (!block) {
+        block = request_space(padded);
+        if (!block) {
+            pthread_mutex_unlock(&heap_lock);
+            errno = ENOMEM;
+            return NULL;
+        }
+    } else {
+        tree_remove(block);
+        block->free = 0;
+    }
+
+    char* payload = (char*)(block + 1);
+    if ((uintptr_t)payload & (alignment - 1)) {
+        char* aligned = (char*)(((uintptr_t)payload + sizeof(block_meta) + MIN_ALLOC_SIZE + alignment - 1) & ~(uintptr_t)(alignment - 1));
+        block_meta* lead = block;
+        block = (block_meta*)aligned - 1;
+        block->size = lead->size - (aligned - payload);
+        block->next = lead->next;
+        block->prev = lead;
+        block->free = 0;
+        block->mmaped = 0;
+        if (lead->next) {
+            lead->next->prev = block;
+        } else {
+            global_tail = block;
+        }
+        lead->next = block;
+        lead->size = (char*)block - payload;
+        lead->free = 1;
+        coalesce(lead);
+    }
+    split_block(block, aligned_size);
+    pthread_mutex_unlock(&heap_lock);
+
+    return (void*)(block + 1);
+}
+
+// POSIX interface: the alignment must also be a multiple of sizeof(void *). Returns 0, EINVAL or ENOMEM.
+int my_posix_memalign(void** memptr, size_t alignment, size_t size) {
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1))) return EINVAL;
+    void* ptr = my_memalign(alignment, size);
+    if (!ptr && size) return ENOMEM;
+    *memptr = ptr;
+    return 0;
+}
+
+// C11 interface: the same as my_memalign
+void* my_aligned_alloc(size_t alignment, size_t size) {
+    return my_memalign(alignment, size);
 }
\ No newline at end of file
@@ -0,0 +1,49 @@
+// C declarations of the allocator in 2021MT10924mmu.h, for C and C++ files of a program that link
+// against mmu_impl.c instead of including the allocator themselves. Only one file of a program may
+// include 2021MT10924mmu.h, which defines every function; this header can be included by any number.
+
+#ifndef MMU_API_H
+#define MMU_API_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MY_MALLOC_ALIGNMENT 8 // Alignment of every my_malloc result (ALIGNMENT in 2021MT10924mmu.h)
+
+void *my_malloc(size_t size);
+void *my_calloc(size_t nmemb, size_t size);
+void my_free(void *ptr);
+void *my_realloc(void *ptr, size_t size);
+void *my_memalign(size_t alignment, size_t size);
+int my_posix_memalign(void **memptr, size_t alignment, size_t size);
+void *my_aligned_alloc(size_t alignment, size_t size);
+size_t my_malloc_batch(size_t size, size_t count, void **out);
+void my_free_batch(void **ptrs, size_t count);
+void my_free_sized(void *ptr, size_t size);
+size_t my_malloc_usable_size(void *ptr);
+void my_malloc_trim(void);
+
+// Bump arenas; the arena itself is only handled through pointers
+typedef struct my_arena my_arena_t;
+
+typedef struct my_arena_mark {
+    struct bump_chunk *chunk;
+    char *cursor;
+} my_arena_mark_t;
+
+my_arena_t *my_arena_create(void);
+void *my_arena_alloc_aligned(my_arena_t *arena, size_t alignment, size_t size);
+void *my_arena_alloc(my_arena_t *arena, size_t size);
+my_arena_mark_t my_arena_mark(my_arena_t *arena);
+void my_arena_rewind(my_arena_t *arena, my_arena_mark_t mark);
+void my_arena_reset(my_arena_t *arena);
+void my_arena_destroy(my_arena_t *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MMU_API_H
@@ -0,0 +1,58 @@
+// The my_malloc / my_free C API over one mmu::Heap from mmu_policy.hpp. The heap's policies are picked
+// when this file is compiled; the defaults give the best-fit, mmap-chunk design.
+//
+// Build: g++ -std=c++17 -O2 -c mmu_facade.cpp
+//        g++ -std=c++17 -O2 -c mmu_facade.cpp -DMMU_FIT=mmu::FirstFit -DMMU_BACKEND=mmu::SbrkBackend
+// Usage: link mmu_facade.o into a program that includes mmu_facade.h
+
+#include "mmu_facade.h"
+#include "mmu_policy.hpp"
+
+#ifndef MMU_FIT
+#define MMU_FIT mmu::BestFit
+#endif
+
+#ifndef MMU_BACKEND
+#define MMU_BACKEND mmu::MmapBackend<>
+#endif
+
+#ifndef MMU_ALIGNMENT
+#define MMU_ALIGNMENT 16
+#endif
+
+#ifndef MMU_MMAP_THRESHOLD
+#define MMU_MMAP_THRESHOLD (128 * 1024)
+#endif
+
+#ifndef MMU_MIN_ALLOC
+#define MMU_MIN_ALLOC 16
+#endif
+
+typedef mmu::Heap<MMU_FIT, MMU_BACKEND, MMU_ALIGNMENT, MMU_MMAP_THRESHOLD, MMU_MIN_ALLOC> heap_t;
+
+// Constant-initialized, so it is usable before any constructor runs
+static heap_t heap;
+
+extern "C" {
+
+void *my_malloc(size_t size) {
+    return heap.allocate(size);
+}
+
+void *my_calloc(size_t nmemb, size_t size) {
+    return heap.allocate_zeroed(nmemb, size);
+}
+
+void *my_realloc(void *ptr, size_t size) {
+    return heap.reallocate(ptr, size);
+}
+
+void my_free(void *ptr) {
+    heap.deallocate(ptr);
+}
+
+size_t my_malloc_usable_size(void *ptr) {
+    return heap_t::usable_size(ptr);
+}
+
+}
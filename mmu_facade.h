@@ -0,0 +1,22 @@
+// C declarations of the allocator built by mmu_facade.cpp, for C and C++ programs linked against it.
+
+#ifndef MMU_FACADE_H
+#define MMU_FACADE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void *my_malloc(size_t size);
+void *my_calloc(size_t nmemb, size_t size);
+void *my_realloc(void *ptr, size_t size);
+void my_free(void *ptr);
+size_t my_malloc_usable_size(void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MMU_FACADE_H
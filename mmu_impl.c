@@ -0,0 +1,7 @@
+// The allocator in 2021MT10924mmu.h compiled once, for programs whose files reach it through mmu_api.h,
+// such as those using the C++ adapters in mmu_pmr.hpp and mmu_object_pool.hpp.
+//
+// Build: gcc -O2 -c mmu_impl.c
+// Usage: link mmu_impl.o (and -lpthread) into a program that includes mmu_api.h
+
+#include "2021MT10924mmu.h"
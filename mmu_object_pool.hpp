@@ -0,0 +1,198 @@
+// Typed pool for hot fixed-size C++ objects, such as the list nodes the TLB simulator in 2021MT10924.cpp
+// creates on every miss:
+//
+//   mmu::ObjectPool<Node> pool;
+//   Node* node = pool.construct(vpn);
+//   pool.destroy(node);
+//
+// Slots are sizeof(T) bytes (at least a pointer) at alignof(T), carved from slabs that come from a bump
+// arena (my_arena_*), so they sit contiguously and cost no header each. Freed slots go on an intrusive
+// free list stored in the slots themselves and are reused first. Destroying the pool unmaps every slab
+// at once; destructors of objects still live at that point are not run.
+//
+// ObjectPool<T> has no locking. ObjectPool<T, true> takes a lock on every call and can be shared between
+// threads; a thread can put a ThreadCache in front of it to take and return slots in batches:
+//
+//   mmu::ObjectPool<Node, true> pool;
+//   ...in each thread:
+//   mmu::ObjectPool<Node, true>::ThreadCache cache(pool);
+//   Node* node = cache.construct(vpn);
+//   cache.destroy(node);
+//
+// The allocator comes in through mmu_api.h, as for mmu_pmr.hpp: link the program with mmu_impl.o.
+
+#ifndef MMU_OBJECT_POOL_HPP
+#define MMU_OBJECT_POOL_HPP
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <pthread.h>
+#include "mmu_api.h"
+
+namespace mmu {
+
+template <class T, bool Shared = false, size_t SlabBytes = 16 * 1024>
+class ObjectPool {
+    union Slot {
+        Slot* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    static constexpr size_t SLAB_SLOTS = SlabBytes / sizeof(Slot) ? SlabBytes / sizeof(Slot) : 1;
+
+    my_arena_t* arena = nullptr;  // Created with the first slab
+    Slot* free_list = nullptr;    // Freed slots, most recent first
+    Slot* cursor = nullptr;       // Slots of the newest slab not handed out yet
+    Slot* end = nullptr;
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+    void lock_pool() {
+        if (Shared) pthread_mutex_lock(&lock);
+    }
+
+    void unlock_pool() {
+        if (Shared) pthread_mutex_unlock(&lock);
+    }
+
+    // Slot from the free list or the newest slab, with the pool locked
+    Slot* take() {
+        if (free_list) {
+            Slot* slot = free_list;
+            free_list = slot->next;
+            return slot;
+        }
+        if (cursor == end) {
+            if (!arena && !(arena = my_arena_create())) throw std::bad_alloc();
+            void* slab = my_arena_alloc_aligned(arena, alignof(Slot), SLAB_SLOTS * sizeof(Slot));
+            if (!slab) throw std::bad_alloc();
+            cursor = static_cast<Slot*>(slab);
+            end = cursor + SLAB_SLOTS;
+        }
+        return cursor++;
+    }
+
+    void give(Slot* slot) {
+        slot->next = free_list;
+        free_list = slot;
+    }
+
+public:
+    ObjectPool() {}
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    ~ObjectPool() {
+        my_arena_destroy(arena);
+        if (Shared) pthread_mutex_destroy(&lock);
+    }
+
+    // Uninitialized storage for one T; throws std::bad_alloc when memory runs out
+    T* allocate() {
+        lock_pool();
+        Slot* slot;
+        try {
+            slot = take();
+        } catch (...) {
+            unlock_pool();
+            throw;
+        }
+        unlock_pool();
+        return reinterpret_cast<T*>(slot->storage);
+    }
+
+    void deallocate(T* ptr) {
+        if (!ptr) return;
+        lock_pool();
+        give(reinterpret_cast<Slot*>(ptr));
+        unlock_pool();
+    }
+
+    template <class... Args>
+    T* construct(Args&&... args) {
+        T* ptr = allocate();
+        try {
+            return new (ptr) T(std::forward<Args>(args)...);
+        } catch (...) {
+            deallocate(ptr);
+            throw;
+        }
+    }
+
+    void destroy(T* ptr) {
+        if (!ptr) return;
+        ptr->~T();
+        deallocate(ptr);
+    }
+
+    // Per-thread front of a shared pool: slots are taken and given back in batches of half its
+    // capacity, so most calls do not touch the pool's lock. It must not outlive the pool, and gives
+    // its slots back when destroyed.
+    class ThreadCache {
+        static_assert(Shared, "A ThreadCache is only useful in front of a shared ObjectPool<T, true>");
+        static constexpr size_t CAPACITY = 64;
+
+        ObjectPool& pool;
+        Slot* slots[CAPACITY];
+        size_t count = 0;
+
+        void refill() {
+            pool.lock_pool();
+            try {
+                while (count < CAPACITY / 2) slots[count++] = pool.take();
+            } catch (...) {
+                pool.unlock_pool();
+                if (!count) throw;  // Keep whatever was taken before memory ran out
+                return;
+            }
+            pool.unlock_pool();
+        }
+
+        void flush(size_t keep) {
+            pool.lock_pool();
+            while (count > keep) pool.give(slots[--count]);
+            pool.unlock_pool();
+        }
+
+    public:
+        explicit ThreadCache(ObjectPool& pool) : pool(pool) {}
+        ThreadCache(const ThreadCache&) = delete;
+        ThreadCache& operator=(const ThreadCache&) = delete;
+
+        ~ThreadCache() {
+            flush(0);
+        }
+
+        T* allocate() {
+            if (!count) refill();
+            return reinterpret_cast<T*>(slots[--count]->storage);
+        }
+
+        void deallocate(T* ptr) {
+            if (!ptr) return;
+            if (count == CAPACITY) flush(CAPACITY / 2);
+            slots[count++] = reinterpret_cast<Slot*>(ptr);
+        }
+
+        template <class... Args>
+        T* construct(Args&&... args) {
+            T* ptr = allocate();
+            try {
+                return new (ptr) T(std::forward<Args>(args)...);
+            } catch (...) {
+                deallocate(ptr);
+                throw;
+            }
+        }
+
+        void destroy(T* ptr) {
+            if (!ptr) return;
+            ptr->~T();
+            deallocate(ptr);
+        }
+    };
+};
+
+}  // namespace mmu
+
+#endif  // MMU_OBJECT_POOL_HPP
@@ -0,0 +1,197 @@
+// C++ adapters over the allocator in 2021MT10924mmu.h, so containers can use it without touching each
+// allocation:
+//
+//   mmu::Allocator<T>         Stateless STL allocator: std::unordered_map<K, V, H, E, mmu::Allocator<...>>
+//   mmu::MemoryResource       std::pmr::memory_resource; mmu::default_resource() returns the shared one
+//   mmu::PoolResource         Per-container pool for node-based std::pmr containers: small objects come
+//                             from chunks it owns and are recycled on its own free lists, with no locking;
+//                             everything is given back at once when the pool is destroyed
+//
+// The allocator is reached through mmu_api.h, so any number of files can include this header; link the
+// program with mmu_impl.o.
+
+#ifndef MMU_PMR_HPP
+#define MMU_PMR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include "mmu_api.h"
+
+namespace mmu {
+
+// Allocate bytes at a multiple of alignment, throwing std::bad_alloc when memory runs out. Zero bytes
+// still get a unique pointer, as std::pmr::memory_resource requires.
+inline void* allocate_bytes(size_t bytes, size_t alignment) {
+    if (!bytes) bytes = 1;
+    void* ptr = alignment > MY_MALLOC_ALIGNMENT ? my_memalign(alignment, bytes) : my_malloc(bytes);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+// Sized free: small objects go straight back to the thread's cache
+inline void deallocate_bytes(void* ptr, size_t bytes) {
+    my_free_sized(ptr, bytes);
+}
+
+template <class T>
+class Allocator {
+public:
+    typedef T value_type;
+
+    Allocator() noexcept {}
+    template <class U>
+    Allocator(const Allocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        if (n > SIZE_MAX / sizeof(T)) throw std::bad_array_new_length();
+        return static_cast<T*>(allocate_bytes(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* ptr, size_t n) noexcept {
+        deallocate_bytes(ptr, n * sizeof(T));
+    }
+};
+
+// Every instance allocates from the same global allocator, so any two compare equal
+template <class T, class U>
+bool operator==(const Allocator<T>&, const Allocator<U>&) noexcept {
+    return true;
+}
+
+template <class T, class U>
+bool operator!=(const Allocator<T>&, const Allocator<U>&) noexcept {
+    return false;
+}
+
+class MemoryResource : public std::pmr::memory_resource {
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        return allocate_bytes(bytes, alignment);
+    }
+
+    void do_deallocate(void* ptr, size_t bytes, size_t) override {
+        deallocate_bytes(ptr, bytes);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return dynamic_cast<const MemoryResource*>(&other) != nullptr;
+    }
+};
+
+inline MemoryResource* default_resource() {
+    static MemoryResource resource;
+    return &resource;
+}
+
+// Objects up to MAX_SIZE bytes are carved from chunks, 16-byte size classes each with a free list.
+// Chunks start small so a short container does not hold a large one, and double up to MAX_CHUNK.
+// Larger or over-aligned requests go to the upstream resource. Not thread-safe: one pool per container
+// (or per group of containers used by one thread).
+class PoolResource : public std::pmr::memory_resource {
+    static constexpr size_t CLASS_SIZE = 16;
+    static constexpr size_t MAX_SIZE = 256;
+    static constexpr size_t CLASSES = MAX_SIZE / CLASS_SIZE;
+    static constexpr size_t MIN_CHUNK = 4096;
+    static constexpr size_t MAX_CHUNK = 64 * 1024;
+
+    struct FreeObject {
+        FreeObject* next;
+    };
+
+    // Start of each chunk, padded to CLASS_SIZE so the objects after it stay aligned
+    struct alignas(CLASS_SIZE) Chunk {
+        Chunk* next;
+        size_t size;
+    };
+
+    std::pmr::memory_resource* upstream;
+    FreeObject* free_lists[CLASSES] = {};
+    Chunk* chunks = nullptr;
+    char* cursor = nullptr;  // Unused part of the newest chunk
+    char* end = nullptr;
+    size_t next_chunk = MIN_CHUNK;
+
+    static size_t class_index(size_t bytes) {
+        return bytes ? (bytes - 1) / CLASS_SIZE : 0;
+    }
+
+    void* carve(size_t size) {
+        size_t rest = end - cursor;
+        if (rest < size) {
+            // The rest of the old chunk, a multiple of CLASS_SIZE below MAX_SIZE, joins its class's free list
+            if (rest) {
+                FreeObject* tail = reinterpret_cast<FreeObject*>(cursor);
+                tail->next = free_lists[class_index(rest)];
+                free_lists[class_index(rest)] = tail;
+            }
+            Chunk* chunk = static_cast<Chunk*>(upstream->allocate(next_chunk, alignof(Chunk)));
+            chunk->next = chunks;
+            chunk->size = next_chunk;
+            chunks = chunk;
+            cursor = reinterpret_cast<char*>(chunk + 1);
+            end = reinterpret_cast<char*>(chunk) + next_chunk;
+            if (next_chunk < MAX_CHUNK) next_chunk *= 2;
+        }
+        void* ptr = cursor;
+        cursor += size;
+        return ptr;
+    }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        if (bytes > MAX_SIZE || alignment > CLASS_SIZE) return upstream->allocate(bytes, alignment);
+        size_t idx = class_index(bytes);
+        FreeObject* object = free_lists[idx];
+        if (object) {
+            free_lists[idx] = object->next;
+            return object;
+        }
+        return carve((idx + 1) * CLASS_SIZE);
+    }
+
+    void do_deallocate(void* ptr, size_t bytes, size_t alignment) override {
+        if (bytes > MAX_SIZE || alignment > CLASS_SIZE) {
+            upstream->deallocate(ptr, bytes, alignment);
+            return;
+        }
+        size_t idx = class_index(bytes);
+        FreeObject* object = static_cast<FreeObject*>(ptr);
+        object->next = free_lists[idx];
+        free_lists[idx] = object;
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+public:
+    explicit PoolResource(std::pmr::memory_resource* upstream = default_resource()) : upstream(upstream) {}
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    ~PoolResource() override {
+        release();
+    }
+
+    // Give every chunk back, invalidating all objects allocated from them
+    void release() {
+        while (chunks) {
+            Chunk* next = chunks->next;
+            upstream->deallocate(chunks, chunks->size, alignof(Chunk));
+            chunks = next;
+        }
+        for (size_t i = 0; i < CLASSES; i++) free_lists[i] = nullptr;
+        cursor = end = nullptr;
+        next_chunk = MIN_CHUNK;
+    }
+
+    std::pmr::memory_resource* upstream_resource() const {
+        return upstream;
+    }
+};
+
+}  // namespace mmu
+
+#endif  // MMU_PMR_HPP
@@ -0,0 +1,415 @@
+// Allocator core shared by the first-fit and best-fit designs, with the choices made at compile time:
+//
+//   mmu::Heap<Fit, Backend, Alignment, MmapThreshold, MinAlloc>
+//
+//   Fit            FirstFit: free blocks on a list by address, the lowest one large enough is taken
+//                  BestFit: free blocks in a treap ordered by (size, address), the smallest fit is taken
+//   Backend        MmapBackend: the heap grows in separately mapped chunks
+//                  SbrkBackend: the heap grows contiguously at the program break
+//   Alignment      Payload alignment, a power of two up to the page size
+//   MmapThreshold  Requests this large (with their header) get a dedicated mapping
+//   MinAlloc       Smallest payload handed out
+//
+// Every policy call is a direct call on a template parameter, so there is no dispatch in the hot path.
+// Blocks carry a header as in mmu.h and are kept in a list in creation order; neighbours only merge when
+// they are adjacent in memory: for sbrk that holds across growths while the break stays aligned, and
+// for mmap only within a chunk.
+// mmu_facade.cpp builds the my_malloc / my_free C API on one Heap.
+
+#ifndef MMU_POLICY_HPP
+#define MMU_POLICY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace mmu {
+
+struct BlockMeta {
+    size_t size;      // Payload bytes
+    BlockMeta* next;  // Next block in the heap's list (NULL for the last one and for mapped blocks)
+    BlockMeta* prev;
+    bool free;
+    bool mapped;      // The block owns a dedicated mapping
+};
+
+constexpr size_t round_up(size_t n, size_t alignment) {
+    return (n + alignment - 1) & ~(alignment - 1);
+}
+
+constexpr bool is_power_of_two(size_t n) {
+    return n && !(n & (n - 1));
+}
+
+// First fit: free blocks on a doubly linked list in address order, so the lowest block that fits is
+// reused and the heap stays packed towards its start; freeing walks the list to the block's place. The
+// links live in the payload, Header bytes past the block.
+struct FirstFit {
+    struct Links {
+        BlockMeta* next;
+        BlockMeta* prev;
+    };
+    static constexpr size_t min_payload = sizeof(Links);
+
+    template <size_t Header>
+    class Index {
+        BlockMeta* head = nullptr;
+
+        static Links* links(BlockMeta* block) {
+            return reinterpret_cast<Links*>(reinterpret_cast<char*>(block) + Header);
+        }
+
+    public:
+        void insert(BlockMeta* block) {
+            BlockMeta* prev = nullptr;
+            BlockMeta* next = head;
+            while (next && next < block) {
+                prev = next;
+                next = links(next)->next;
+            }
+            links(block)->prev = prev;
+            links(block)->next = next;
+            if (prev) links(prev)->next = block;
+            else head = block;
+            if (next) links(next)->prev = block;
+        }
+
+        void remove(BlockMeta* block) {
+            Links* l = links(block);
+            if (l->prev) links(l->prev)->next = l->next;
+            else head = l->next;
+            if (l->next) links(l->next)->prev = l->prev;
+        }
+
+        BlockMeta* find(size_t size) const {
+            for (BlockMeta* block = head; block; block = links(block)->next) {
+                if (block->size >= size) return block;
+            }
+            return nullptr;
+        }
+    };
+};
+
+// Best fit: free blocks in a treap ordered by (size, address), as in mmu.h, so the smallest block that
+// fits is found in one descent. Node priorities are a hash of the block's address.
+struct BestFit {
+    struct Links {
+        BlockMeta* left;
+        BlockMeta* right;
+    };
+    static constexpr size_t min_payload = sizeof(Links);
+
+    template <size_t Header>
+    class Index {
+        BlockMeta* root = nullptr;
+
+        static Links* links(BlockMeta* block) {
+            return reinterpret_cast<Links*>(reinterpret_cast<char*>(block) + Header);
+        }
+
+        static uintptr_t priority(BlockMeta* block) {
+            return (reinterpret_cast<uintptr_t>(block) * 0x9E3779B97F4A7C15ULL) >> 7;
+        }
+
+        static bool less(BlockMeta* a, BlockMeta* b) {
+            return a->size < b->size || (a->size == b->size && a < b);
+        }
+
+        // Split the subtree at root into blocks ordered before key (*lo) and after it (*hi)
+        static void split(BlockMeta* root, BlockMeta* key, BlockMeta** lo, BlockMeta** hi) {
+            while (root) {
+                if (less(root, key)) {
+                    *lo = root;
+                    lo = &links(root)->right;
+                    root = links(root)->right;
+                } else {
+                    *hi = root;
+                    hi = &links(root)->left;
+                    root = links(root)->left;
+                }
+            }
+            *lo = nullptr;
+            *hi = nullptr;
+        }
+
+    public:
+        void insert(BlockMeta* block) {
+            BlockMeta** link = &root;
+            while (*link && priority(*link) > priority(block)) {
+                link = less(block, *link) ? &links(*link)->left : &links(*link)->right;
+            }
+            split(*link, block, &links(block)->left, &links(block)->right);
+            *link = block;
+        }
+
+        void remove(BlockMeta* block) {
+            BlockMeta** link = &root;
+            while (*link != block) {
+                link = less(block, *link) ? &links(*link)->left : &links(*link)->right;
+            }
+            // Replace the block by the merge of its two subtrees
+            BlockMeta* left = links(block)->left;
+            BlockMeta* right = links(block)->right;
+            while (left && right) {
+                if (priority(left) > priority(right)) {
+                    *link = left;
+                    link = &links(left)->right;
+                    left = links(left)->right;
+                } else {
+                    *link = right;
+                    link = &links(right)->left;
+                    right = links(right)->left;
+                }
+            }
+            *link = left ? left : right;
+        }
+
+        BlockMeta* find(size_t size) const {
+            BlockMeta* best = nullptr;
+            BlockMeta* current = root;
+            while (current) {
+                if (current->size >= size) {
+                    best = current;
+                    current = links(current)->left;
+                } else {
+                    current = links(current)->right;
+                }
+            }
+            return best;
+        }
+    };
+};
+
+// Backends hand the heap more memory: grow() returns at least bytes (updating bytes to what it gave)
+// or NULL.
+
+// The program break: each grow continues the previous range, so the heap stays contiguous
+struct SbrkBackend {
+    static void* grow(size_t& bytes) {
+        void* mem = sbrk(static_cast<intptr_t>(bytes));
+        return mem == reinterpret_cast<void*>(-1) ? nullptr : mem;
+    }
+};
+
+// Separate mappings of at least ChunkSize bytes, so small requests do not map a page each
+template <size_t ChunkSize = 1024 * 1024>
+struct MmapBackend {
+    static void* grow(size_t& bytes) {
+        size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        bytes = round_up(bytes > ChunkSize ? bytes : ChunkSize, page_size);
+        void* mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return mem == MAP_FAILED ? nullptr : mem;
+    }
+};
+
+template <class Fit, class Backend, size_t Alignment = 16, size_t MmapThreshold = 128 * 1024,
+          size_t MinAlloc = 16>
+class Heap {
+    static_assert(is_power_of_two(Alignment) && Alignment >= alignof(BlockMeta),
+                  "Alignment must be a power of two that suits the block header");
+    static_assert(Alignment <= 4096, "Alignment above a page is not supported");
+
+    static constexpr size_t header_size = round_up(sizeof(BlockMeta), Alignment);
+    // Smallest payload: MinAlloc, and room for the fit policy's links once the block is free
+    static constexpr size_t min_payload =
+        round_up(MinAlloc > Fit::min_payload ? MinAlloc : Fit::min_payload, Alignment);
+
+    typename Fit::template Index<header_size> free_blocks;
+    BlockMeta* head = nullptr;  // First block of the heap's list
+    BlockMeta* tail = nullptr;  // Last block, so growing the heap needs no list walk
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+    static void* payload(BlockMeta* block) {
+        return reinterpret_cast<char*>(block) + header_size;
+    }
+
+    static BlockMeta* block_of(void* ptr) {
+        return reinterpret_cast<BlockMeta*>(static_cast<char*>(ptr) - header_size);
+    }
+
+    static bool adjacent(BlockMeta* a, BlockMeta* b) {
+        return static_cast<char*>(payload(a)) + a->size == reinterpret_cast<char*>(b);
+    }
+
+    // Payload size for a request: at least min_payload, a multiple of Alignment; 0 if it overflows
+    static size_t payload_size(size_t size) {
+        if (size > SIZE_MAX - header_size - MmapThreshold) return 0;
+        return size < min_payload ? min_payload : round_up(size, Alignment);
+    }
+
+    // Absorb b, which follows a in the list and in memory, into a
+    void merge(BlockMeta* a, BlockMeta* b) {
+        a->size += header_size + b->size;
+        a->next = b->next;
+        if (b->next) b->next->prev = a;
+        else tail = a;
+    }
+
+    // Split the block if there's excess space after allocation
+    void split(BlockMeta* block, size_t size) {
+        if (block->size < size + header_size + min_payload) return;
+        BlockMeta* rest = reinterpret_cast<BlockMeta*>(static_cast<char*>(payload(block)) + size);
+        rest->size = block->size - size - header_size;
+        rest->next = block->next;
+        rest->prev = block;
+        rest->free = true;
+        rest->mapped = false;
+        if (block->next) block->next->prev = rest;
+        else tail = rest;
+        block->next = rest;
+        block->size = size;
+        coalesce(rest);
+    }
+
+    // Merge a free block with free neighbours and index the result
+    void coalesce(BlockMeta* block) {
+        if (block->next && block->next->free && adjacent(block, block->next)) {
+            free_blocks.remove(block->next);
+            merge(block, block->next);
+        }
+        if (block->prev && block->prev->free && adjacent(block->prev, block)) {
+            free_blocks.remove(block->prev);
+            merge(block->prev, block);
+            block = block->prev;
+        }
+        free_blocks.insert(block);
+    }
+
+    // Get memory for a size-byte block from the backend and append it to the list
+    BlockMeta* extend(size_t size) {
+        size_t bytes = header_size + size + Alignment;  // Slack to align the block if the backend does not
+        char* mem = static_cast<char*>(Backend::grow(bytes));
+        if (!mem) return nullptr;
+
+        char* start = reinterpret_cast<char*>(round_up(reinterpret_cast<uintptr_t>(mem), Alignment));
+        BlockMeta* block = reinterpret_cast<BlockMeta*>(start);
+        block->size = (mem + bytes - start - header_size) & ~(Alignment - 1);
+        block->next = nullptr;
+        block->prev = tail;
+        block->free = false;
+        block->mapped = false;
+        if (tail) tail->next = block;
+        else head = block;
+        tail = block;
+
+        // A free block ending where the new one starts becomes part of it. With sbrk the growths are
+        // contiguous, but an unaligned break leaves a gap of less than Alignment and the blocks stay apart
+        BlockMeta* prev = block->prev;
+        if (prev && prev->free && adjacent(prev, block)) {
+            free_blocks.remove(prev);
+            merge(prev, block);
+            prev->free = false;
+            block = prev;
+        }
+        split(block, size);
+        return block;
+    }
+
+    static BlockMeta* map_block(size_t size) {
+        size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t bytes = round_up(header_size + size, page_size);
+        void* mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) return nullptr;
+        BlockMeta* block = static_cast<BlockMeta*>(mem);
+        block->size = bytes - header_size;
+        block->next = nullptr;
+        block->prev = nullptr;
+        block->free = false;
+        block->mapped = true;
+        return block;
+    }
+
+public:
+    void* allocate(size_t size) {
+        if (size == 0) return nullptr;
+        size = payload_size(size);
+        if (!size) return nullptr;
+        if (header_size + size >= MmapThreshold) {
+            // Mapped blocks stay out of the block list, so they need no lock
+            BlockMeta* block = map_block(size);
+            return block ? payload(block) : nullptr;
+        }
+
+        pthread_mutex_lock(&lock);
+        BlockMeta* block = free_blocks.find(size);
+        if (block) {
+            free_blocks.remove(block);
+            block->free = false;
+            split(block, size);
+        } else {
+            block = extend(size);
+        }
+        pthread_mutex_unlock(&lock);
+        return block ? payload(block) : nullptr;
+    }
+
+    void deallocate(void* ptr) {
+        if (!ptr) return;
+        BlockMeta* block = block_of(ptr);
+        if (block->mapped) {
+            munmap(block, header_size + block->size);
+            return;
+        }
+        pthread_mutex_lock(&lock);
+        if (!block->free) {  // A double free must not index the block twice
+            block->free = true;
+            coalesce(block);
+        }
+        pthread_mutex_unlock(&lock);
+    }
+
+    void* allocate_zeroed(size_t nmemb, size_t size) {
+        size_t total;
+        if (__builtin_mul_overflow(nmemb, size, &total)) return nullptr;
+        void* ptr = allocate(total);
+        if (ptr && !block_of(ptr)->mapped) {  // A fresh mapping is already zero
+            memset(ptr, 0, total);
+        }
+        return ptr;
+    }
+
+    void* reallocate(void* ptr, size_t size) {
+        if (!ptr) return allocate(size);
+        if (size == 0) {
+            deallocate(ptr);
+            return nullptr;
+        }
+        BlockMeta* block = block_of(ptr);
+        size_t needed = payload_size(size);
+        if (!needed) return nullptr;
+        if (block->size >= needed) return ptr;
+
+        if (!block->mapped) {
+            // Grow into the following block if it is free and adjacent
+            pthread_mutex_lock(&lock);
+            BlockMeta* next = block->next;
+            bool grown = next && next->free && adjacent(block, next) &&
+                         block->size + header_size + next->size >= needed;
+            if (grown) {
+                free_blocks.remove(next);
+                merge(block, next);
+                split(block, needed);
+            }
+            pthread_mutex_unlock(&lock);
+            if (grown) return ptr;
+        }
+
+        void* moved = allocate(size);
+        if (!moved) return nullptr;
+        memcpy(moved, ptr, block->size);
+        deallocate(ptr);
+        return moved;
+    }
+
+    // Bytes usable at ptr, at least the size requested
+    static size_t usable_size(void* ptr) {
+        return ptr ? block_of(ptr)->size : 0;
+    }
+};
+
+}  // namespace mmu
+
+#endif  // MMU_POLICY_HPP
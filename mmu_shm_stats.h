@@ -0,0 +1,32 @@
+// Layout of the stats page 2021MT10924mmu.h publishes under /dev/shm, shared with heapmon.c so the
+// monitor can read it without including the allocator.
+
+#ifndef MMU_SHM_STATS_H
+#define MMU_SHM_STATS_H
+
+#include <stdint.h>
+
+#define STATS_SHM_MAGIC 0x4d4d5553 // "SUMM"
+#define STATS_SHM_VERSION 2
+#define STATS_SHM_MAX_ARENAS 64    // Room in arena_live; the allocator's MAX_ARENAS may not exceed it
+#define STATS_SHM_SLAB_CLASSES 16  // Slab size classes, of STATS_SHM_SLAB_ALIGN bytes each
+#define STATS_SHM_SLAB_ALIGN 16
+
+// Writers use relaxed atomics; a reader sees each field torn-free but the fields are not a consistent
+// snapshot of one moment.
+typedef struct shm_stats {
+    uint32_t magic;                                 // STATS_SHM_MAGIC once the page is set up
+    uint32_t version;                               // STATS_SHM_VERSION
+    int32_t pid;                                    // Process publishing the page
+    uint32_t arenas;                                // Number of entries used in arena_live
+    uint64_t allocations;                           // Total my_malloc calls; threads add theirs when they lock an arena
+    uint64_t frees;                                 // Total my_free calls, likewise
+    uint64_t mapped;                                // Bytes mapped from the OS
+    uint64_t peak_mapped;                           // Most bytes ever mapped at once
+    uint64_t direct_live;                           // Payload bytes of blocks with a dedicated mapping
+    uint64_t arena_live[STATS_SHM_MAX_ARENAS];      // Bytes in use per arena, as of its last unlock
+    uint64_t slab_objects[STATS_SHM_SLAB_CLASSES];  // Slab objects handed out per class (thread caches included)
+    uint64_t slab_capacity[STATS_SHM_SLAB_CLASSES]; // Objects that fit in the slabs currently assigned to each class
+} shm_stats_t;
+
+#endif // MMU_SHM_STATS_H
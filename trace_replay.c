@@ -0,0 +1,242 @@
+// Replays an allocation trace recorded by 2021MT10924mmu.h (MY_MALLOC_TRACE=<file> in the environment,
+// or my_malloc_trace_start("<file>")) against my_malloc and against the system malloc.
+// The calls are replayed on one thread in the order of their timestamps, each allocator in its own
+// child process, and the throughput, per-call latency percentiles and peak RSS are reported.
+//
+// Build: gcc -O2 trace_replay.c -o trace_replay -lpthread
+// Usage: ./trace_replay <trace>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "2021MT10924mmu.h"
+
+#define NO_SLOT UINT32_MAX
+
+// A call with the traced pointers replaced by slot numbers
+typedef struct replay_op {
+    uint8_t op;
+    uint32_t slot;     // Slot the result goes to, or that is freed
+    uint32_t old_slot; // Realloc: slot holding the pointer passed in, or NO_SLOT for realloc(NULL, ...)
+    size_t size;
+    size_t alignment;  // Memalign: the alignment requested
+} replay_op;
+
+typedef struct allocator {
+    const char *name;
+    void *(*alloc)(size_t);
+    void *(*zalloc)(size_t, size_t);
+    void *(*resize)(void *, size_t);
+    void (*release)(void *);
+    int (*align)(void **, size_t, size_t);
+} allocator;
+
+static trace_record_t *records;
+static size_t record_count;
+
+// Map from live traced addresses to slots: open addressing with tombstones
+static uint64_t *map_keys;  // 0 = empty, 1 = tombstone
+static uint32_t *map_slots;
+static size_t map_mask;
+
+static size_t map_find(uint64_t key) {
+    size_t i = (size_t)(key * 0x9E3779B97F4A7C15ULL >> 17) & map_mask;
+    while (map_keys[i] && map_keys[i] != key) i = (i + 1) & map_mask;
+    return i;
+}
+
+static uint32_t map_take(uint64_t key) {
+    size_t i = map_find(key);
+    if (!map_keys[i]) return NO_SLOT;
+    map_keys[i] = 1;
+    return map_slots[i];
+}
+
+static void map_put(uint64_t key, uint32_t slot) {
+    size_t i = (size_t)(key * 0x9E3779B97F4A7C15ULL >> 17) & map_mask;
+    while (map_keys[i] > 1) i = (i + 1) & map_mask;
+    map_keys[i] = key;
+    map_slots[i] = slot;
+}
+
+// Order by time; records of one thread keep their order when timestamps tie
+static int by_time(const void *a, const void *b) {
+    const trace_record_t *x = (const trace_record_t *)a, *y = (const trace_record_t *)b;
+    if (x->time_ns != y->time_ns) return x->time_ns < y->time_ns ? -1 : 1;
+    return x < y ? -1 : x > y;
+}
+
+static int by_value(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Translate the records into replay ops; returns the number of ops and sets *slot_count
+static size_t build_ops(replay_op *ops, uint32_t *slot_count) {
+    size_t table = 1;
+    while (table < 2 * record_count + 2) table *= 2;
+    map_keys = (uint64_t *)calloc(table, sizeof(uint64_t));
+    map_slots = (uint32_t *)calloc(table, sizeof(uint32_t));
+    map_mask = table - 1;
+    uint32_t *free_slots = (uint32_t *)malloc((record_count + 1) * sizeof(uint32_t));
+    size_t free_count = 0;
+    uint32_t slots = 0;
+    size_t n = 0;
+
+    for (size_t i = 0; i < record_count; i++) {
+        trace_record_t *r = &records[i];
+        if (r->op == TRACE_FREE) {
+            uint32_t slot = map_take(r->ptr);
+            if (slot == NO_SLOT) continue; // Allocated before recording started
+            ops[n++] = (replay_op){ TRACE_FREE, slot, NO_SLOT, 0, 0 };
+            free_slots[free_count++] = slot;
+            continue;
+        }
+
+        uint32_t old_slot = NO_SLOT;
+        if (r->op == TRACE_REALLOC && r->old_ptr) {
+            old_slot = map_take(r->old_ptr);
+            if (old_slot == NO_SLOT && !r->ptr) continue;
+            if (!r->ptr) {
+                // realloc(p, 0) frees p; a failed realloc leaves it alone
+                if (r->size) map_put(r->old_ptr, old_slot);
+                else {
+                    ops[n++] = (replay_op){ TRACE_FREE, old_slot, NO_SLOT, 0, 0 };
+                    free_slots[free_count++] = old_slot;
+                }
+                continue;
+            }
+        }
+        if (!r->ptr) continue; // Failed allocation
+
+        // A live address being handed out again means its free was recorded later than it happened
+        uint32_t stale = map_take(r->ptr);
+        if (stale != NO_SLOT) {
+            ops[n++] = (replay_op){ TRACE_FREE, stale, NO_SLOT, 0, 0 };
+            free_slots[free_count++] = stale;
+        }
+        uint32_t slot = old_slot != NO_SLOT ? old_slot : free_count ? free_slots[--free_count] : slots++;
+        ops[n++] = (replay_op){ r->op, slot, old_slot, (size_t)r->size,
+                                  r->op == TRACE_MEMALIGN ? (size_t)r->old_ptr : 0 };
+        map_put(r->ptr, slot);
+    }
+    free(free_slots);
+    free(map_keys);
+    free(map_slots);
+    *slot_count = slots;
+    return n;
+}
+
+static long long clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long peak_rss_kb(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Replay every op against one allocator and print one result line (runs in a child process)
+static void replay(const allocator *a, replay_op *ops, size_t n, uint32_t slot_count) {
+    void **slots = (void **)calloc(slot_count + 1, sizeof(void *));
+    uint32_t *latency = (uint32_t *)malloc((n + 1) * sizeof(uint32_t));
+    long base_rss = peak_rss_kb();
+
+    long long begin = clock_ns();
+    for (size_t i = 0; i < n; i++) {
+        replay_op *op = &ops[i];
+        long long start = clock_ns();
+        switch (op->op) {
+        case TRACE_MALLOC:
+            slots[op->slot] = a->alloc(op->size);
+            if (slots[op->slot]) *(char *)slots[op->slot] = 1; // Touch it, as the traced program did
+            break;
+        case TRACE_CALLOC:
+            slots[op->slot] = a->zalloc(op->size, 1);
+            break;
+        case TRACE_MEMALIGN:
+            if (a->align(&slots[op->slot], op->alignment < sizeof(void *) ? sizeof(void *) : op->alignment, op->size)) {
+                slots[op->slot] = NULL;
+            }
+            break;
+        case TRACE_REALLOC:
+            slots[op->slot] = a->resize(op->old_slot == NO_SLOT ? NULL : slots[op->old_slot], op->size);
+            break;
+        case TRACE_FREE:
+            a->release(slots[op->slot]);
+            slots[op->slot] = NULL;
+            break;
+        }
+        long long took = clock_ns() - start;
+        latency[i] = took > UINT32_MAX ? UINT32_MAX : (uint32_t)took;
+    }
+    double elapsed = (clock_ns() - begin) / 1e9;
+
+    qsort(latency, n, sizeof(uint32_t), by_value);
+    printf("%-10s %12zu %12.0f %8u %8u %8u %10u %12ld\n", a->name, n, n / elapsed,
+           latency[n / 2], latency[n * 99 / 100], latency[n * 999 / 1000], latency[n - 1],
+           peak_rss_kb() - base_rss);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <trace>\n", argv[0]);
+        return 1;
+    }
+    int fd = open(argv[1], O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    trace_header_t *header = (trace_header_t *)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED || (size_t)st.st_size < sizeof(trace_header_t) ||
+        memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != TRACE_VERSION || header->record_size != sizeof(trace_record_t)) {
+        fprintf(stderr, "%s: not a trace of this allocator version\n", argv[1]);
+        return 1;
+    }
+
+    record_count = ((size_t)st.st_size - sizeof(trace_header_t)) / sizeof(trace_record_t);
+    records = (trace_record_t *)malloc((record_count + 1) * sizeof(trace_record_t));
+    memcpy(records, header + 1, record_count * sizeof(trace_record_t));
+    munmap(header, (size_t)st.st_size);
+    qsort(records, record_count, sizeof(trace_record_t), by_time);
+
+    replay_op *ops = (replay_op *)malloc((2 * record_count + 1) * sizeof(replay_op));
+    uint32_t slot_count;
+    size_t n = build_ops(ops, &slot_count);
+    free(records);
+    if (!n) {
+        fprintf(stderr, "%s: no calls to replay\n", argv[1]);
+        return 1;
+    }
+    printf("%zu records, %zu calls replayed, %u live slots at most\n", record_count, n, slot_count);
+
+    allocator allocators[] = {
+        { "my_malloc", my_malloc, my_calloc, my_realloc, my_free, my_posix_memalign },
+        { "malloc", malloc, calloc, realloc, free, posix_memalign },
+    };
+    printf("%-10s %12s %12s %8s %8s %8s %10s %12s\n", "allocator", "calls", "calls/s", "p50_ns", "p99_ns",
+           "p999_ns", "max_ns", "peak_rss_kb");
+    fflush(stdout);
+    for (size_t i = 0; i < sizeof(allocators) / sizeof(allocators[0]); i++) {
+        // A fresh process per allocator, so neither sees the other's heap or RSS
+        pid_t pid = fork();
+        if (pid == 0) {
+            replay(&allocators[i], ops, n, slot_count);
+            _exit(0);
+        }
+        waitpid(pid, NULL, 0);
+    }
+    return 0;
+}